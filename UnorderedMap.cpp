@@ -1,129 +1,785 @@
 #include <iostream>
 #include <vector>
-#include <list>
 #include <algorithm>
 #include <functional>
 #include <stdexcept>
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <optional>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <iterator>
+#include <array>
+#include <utility>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "MemoryPool.h"
 using namespace std;
-template <typename Key, typename Value>
-class UnorderedMap {
+
+/*
+    Bucket policies : decide how many buckets the table has and how a hash value is mapped onto one of them.
+    Each policy exposes
+    - bucket_count_for(requested) : the bucket count actually used when `requested` buckets are asked for
+    - index_for(hash, bucket_count) : the bucket a hash value lands in
+*/
+
+// Any bucket count, index = hash % bucket_count : one 64-bit division on every operation
+struct ModuloBucketPolicy {
+    static size_t bucket_count_for(size_t requested) {
+        return requested == 0 ? 1 : requested;
+    }
+    static size_t index_for(size_t hash, size_t bucket_count) {
+        return hash % bucket_count;
+    }
+};
+
+// Power of two bucket count with fibonacci hashing (multiply-shift) : one multiply and one shift, no division
+struct PowerOfTwoBucketPolicy {
+    static size_t bucket_count_for(size_t requested) {
+        size_t count = 2; // at least 2 so the shift below stays below 64
+        while (count < requested) {
+            count <<= 1;
+        }
+        return count;
+    }
+    static size_t index_for(size_t hash, size_t bucket_count) {
+        /*
+            - multiply by 2^64 / golden ratio : every input bit influences the high bits of the product
+            - keep the top log2(bucket_count) bits
+            - identity hashes (std::hash<int>) of sequential or strided keys spread evenly instead of piling up in a few buckets
+        */
+        return static_cast<size_t>((static_cast<uint64_t>(hash) * 11400714819323198485ull) >> (64 - __builtin_ctzll(bucket_count)));
+    }
+};
+
+// Any bucket count, index = high 64 bits of mixed_hash * bucket_count (Lemire's fastrange) : a multiply instead of a division
+struct FastRangeBucketPolicy {
+    static size_t bucket_count_for(size_t requested) {
+        return requested == 0 ? 1 : requested;
+    }
+    static size_t index_for(size_t hash, size_t bucket_count) {
+        uint64_t mixed = static_cast<uint64_t>(hash) * 11400714819323198485ull; // fastrange uses the high bits, so spread the low bits up first
+        return static_cast<size_t>((static_cast<unsigned __int128>(mixed) * bucket_count) >> 64);
+    }
+};
+
+// Transparent hash for string keys : std::string, std::string_view and const char* all hash through
+// std::hash<std::string_view>, which gives the same value as std::hash<std::string> for the same characters
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view key) const {
+        return std::hash<std::string_view>{}(key);
+    }
+};
+
+// true when T declares is_transparent (std::equal_to<>, StringHash, ...)
+template <typename T, typename = void>
+struct has_is_transparent : std::false_type {};
+template <typename T>
+struct has_is_transparent<T, std::void_t<typename T::is_transparent>> : std::true_type {};
+
+/*
+    Hash flooding defense : std::hash is unkeyed (the identity for integers), so whoever chooses the keys can
+    compute their buckets offline and pile them all into one chain, turning every lookup into an O(n) walk.
+    - SeededHash runs SipHash-1-3 keyed with a 128-bit secret drawn for each instance : collisions cannot be
+      computed without the secret
+    - UnorderedMap recognizes a Hash with reseed() : if an insert leaves a chain longer than kMaxChainLength,
+      the hash is reseeded and every cached hash recomputed, which scatters the colliding keys again
+*/
+inline uint64_t rotate_left(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+// SipHash with 1 compression round and 3 finalization rounds, message words read in native (little endian) order
+inline uint64_t siphash13(const void* data, size_t length, uint64_t k0, uint64_t k1) {
+    uint64_t v0 = 0x736f6d6570736575ull ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dull ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ull ^ k0;
+    uint64_t v3 = 0x7465646279746573ull ^ k1;
+    auto sip_round = [&] {
+        v0 += v1; v1 = rotate_left(v1, 13); v1 ^= v0; v0 = rotate_left(v0, 32);
+        v2 += v3; v3 = rotate_left(v3, 16); v3 ^= v2;
+        v0 += v3; v3 = rotate_left(v3, 21); v3 ^= v0;
+        v2 += v1; v1 = rotate_left(v1, 17); v1 ^= v2; v2 = rotate_left(v2, 32);
+    };
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    const unsigned char* words_end = bytes + (length & ~size_t(7));
+    for (; bytes != words_end; bytes += 8) {
+        uint64_t m;
+        std::memcpy(&m, bytes, 8);
+        v3 ^= m;
+        sip_round();
+        v0 ^= m;
+    }
+    uint64_t last = static_cast<uint64_t>(length) << 56;
+    for (size_t i = 0; i < (length & 7); ++i) {
+        last |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    }
+    v3 ^= last;
+    sip_round();
+    v0 ^= last;
+    v2 ^= 0xff;
+    sip_round();
+    sip_round();
+    sip_round();
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+// Fresh 64-bit secret : the process draws one value from std::random_device, each call then mixes in a counter (splitmix64)
+inline uint64_t random_seed() {
+    static const uint64_t process_seed = (static_cast<uint64_t>(std::random_device{}()) << 32) ^ std::random_device{}() ^
+                                         static_cast<uint64_t>(chrono::steady_clock::now().time_since_epoch().count());
+    static std::atomic<uint64_t> counter{0};
+    uint64_t z = process_seed + (counter.fetch_add(1, std::memory_order_relaxed) + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Keyed hash for integers, other padding-free trivially copyable keys and strings (transparent, like StringHash)
+class SeededHash {
 private:
+    uint64_t k0_;
+    uint64_t k1_;
+
+public:
+    using is_transparent = void;
+
+    SeededHash() : k0_(random_seed()), k1_(random_seed()) {}
+
+    size_t operator()(std::string_view key) const {
+        return siphash13(key.data(), key.size(), k0_, k1_);
+    }
+    template <typename T, typename = std::enable_if_t<std::is_trivially_copyable_v<T> && std::has_unique_object_representations_v<T> &&
+                                                      !std::is_pointer_v<T> && !std::is_array_v<T>>>
+    size_t operator()(const T& key) const {
+        return siphash13(&key, sizeof(T), k0_, k1_);
+    }
+
+    // Draw a new secret : every hash computed before is invalid
+    void reseed() {
+        k0_ = random_seed();
+        k1_ = random_seed();
+    }
+};
+
+// true when Hash can be reseeded (SeededHash)
+template <typename T, typename = void>
+struct has_reseed : std::false_type {};
+template <typename T>
+struct has_reseed<T, std::void_t<decltype(std::declval<T&>().reseed())>> : std::true_type {};
+
+// Expected number of elements, for the UnorderedMap constructor that sizes the table up front
+struct ExpectedSize {
+    size_t count;
+};
+
+/*
+    Statistics policies : the last UnorderedMap template parameter.
+    NoMapStats (the default) has enabled = false, every recording site is behind `if constexpr (Stats::enabled)`
+    and disappears from the generated code. MapStats records :
+    - hits / misses of every key search (lookups, and the existence check done by inserts)
+    - probe length histogram : probe_lengths[n] = searches that compared n entries (the last slot counts n or more)
+    - rehash count and total time spent rehashing
+    - load factor over time : (size, load factor) sampled right before each rehash
+    Recording happens inside const lookups, so a map with MapStats must not be read from several threads at once.
+*/
+struct NoMapStats {
+    static constexpr bool enabled = false;
+};
+
+struct MapStats {
+    static constexpr bool enabled = true;
+    static constexpr size_t kMaxProbeLength = 16;
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t probe_lengths[kMaxProbeLength + 1] = {};
+    uint64_t rehash_count = 0;
+    double rehash_seconds = 0;
+    uint64_t reseed_count = 0; // chain length guard of a reseedable Hash fired
+    std::vector<std::pair<size_t, float>> load_factor_samples;
+
+    void record_search(size_t probes, bool hit) {
+        ++(hit ? hits : misses);
+        ++probe_lengths[std::min(probes, kMaxProbeLength)];
+    }
+
+    double mean_probe_length() const {
+        uint64_t searches = 0, probes = 0;
+        for (size_t n = 0; n <= kMaxProbeLength; ++n) {
+            searches += probe_lengths[n];
+            probes += n * probe_lengths[n];
+        }
+        return searches == 0 ? 0.0 : static_cast<double>(probes) / searches;
+    }
+
+    void print(std::ostream& out) const {
+        out << "hits " << hits << ", misses " << misses << ", mean probe length " << mean_probe_length()
+            << ", rehashes " << rehash_count << " (" << rehash_seconds * 1e3 << " ms), reseeds " << reseed_count << endl;
+        out << "probe lengths :";
+        for (size_t n = 0; n <= kMaxProbeLength; ++n) {
+            if (probe_lengths[n] != 0) {
+                out << " " << n << (n == kMaxProbeLength ? "+" : "") << ":" << probe_lengths[n];
+            }
+        }
+        out << endl << "load factor before each rehash :";
+        for (const auto& sample : load_factor_samples) {
+            out << " " << sample.first << "@" << sample.second;
+        }
+        out << endl;
+    }
+};
+
+// Software prefetch hint : asks the CPU to start loading the cache line at address, no effect on program state
+inline void prefetch_for_read(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address, 0 /* read */, 3 /* keep in all cache levels */);
+#else
+    (void)address;
+#endif
+}
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>,
+          typename BucketPolicy = PowerOfTwoBucketPolicy, typename Stats = NoMapStats>
+class UnorderedMap {
+public:
     struct KeyValuePair {
-        Key key;
+        Key key; // must not be modified through an iterator, the entry would be left in the wrong bucket
         Value value;
         KeyValuePair(const Key& k, const Value& v) : key(k), value(v) {}
+        // Forwarding ctor used by emplace/try_emplace : key and value are built in place, never copied
+        //   never picked for a KeyValuePair argument, so copying a non-const pair still uses the copy ctor
+        template <typename K, typename... Args, typename = std::enable_if_t<!std::is_same_v<std::decay_t<K>, KeyValuePair>>>
+        KeyValuePair(K&& k, Args&&... args) : key(std::forward<K>(k)), value(std::forward<Args>(args)...) {}
+    };
+    using value_type = KeyValuePair;
+
+private:
+    static constexpr size_t npos = static_cast<size_t>(-1); // "no entry" : end of a chain or an empty bucket
+    static constexpr size_t kPrefetchDistance = 32;        // batch APIs prefetch the bucket of key i + kPrefetchDistance while probing key i
+    static constexpr size_t kMaxChainLength = 16;          // longer chain after an insert : a reseedable Hash is reseeded
+
+    // One slot of the dense entry array
+    struct Entry {
+        size_t hash;                      // full hash, cached so rehash never calls Hash again
+        size_t next;                      // index of the next entry in the same bucket, npos at the end of the chain
+        std::optional<KeyValuePair> pair; // empty once erased (tombstone), dropped by the next compaction
+        template <typename... Args>
+        Entry(size_t h, size_t n, Args&&... args) : hash(h), next(n), pair(std::in_place, std::forward<Args>(args)...) {}
     };
 
-    std::vector<std::list<KeyValuePair>>* buckets;
-    size_t size_;
-    size_t bucket_count_;
+    std::vector<Entry> entries_;   // every entry in insertion order : iteration is a linear sweep of this array
+    std::vector<size_t> buckets_;  // index of the first entry of each bucket's chain, npos when the bucket is empty
+    size_t size_;                  // live entries (entries_.size() minus tombstones)
+    size_t front_;                 // every entry before this index is a tombstone : oldest-entry lookups start here
     float max_load_factor_;
+    Hash hasher_;
+    KeyEqual key_eq_;
+    mutable Stats stats_;          // recorded from const lookups too, see NoMapStats / MapStats
+
+    /*
+        Heterogeneous lookup : when both Hash and KeyEqual are transparent, contains/find/erase/operator[]
+        accept any K they can hash and compare against Key (e.g. const char* or string_view for string keys),
+        so a lookup never builds a temporary Key. Key itself keeps using the regular overloads.
+    */
+    template <typename K>
+    using enable_if_heterogeneous = std::enable_if_t<has_is_transparent<Hash>::value && has_is_transparent<KeyEqual>::value &&
+                                                     !std::is_same_v<std::decay_t<K>, Key>>;
+
+    // Hash function : the bucket policy turns the full hash into a bucket index
+    size_t bucket_for(size_t full_hash) const {
+        return BucketPolicy::index_for(full_hash, buckets_.size());
+    }
+
+    // this returns the index of the entry holding key, or npos
+    template <typename K>
+    size_t find_index(const K& key, size_t full_hash) const {
+        return find_index(key, full_hash, bucket_for(full_hash));
+    }
+    template <typename K>
+    size_t find_index(const K& key, size_t full_hash, size_t bucket) const {
+        size_t probes = 0;
+        for (size_t i = buckets_[bucket]; i != npos; i = entries_[i].next) {
+            ++probes;
+            // the cached hash is compared first : most non-matching entries are rejected without touching the key
+            if (entries_[i].hash == full_hash && key_eq_(entries_[i].pair->key, key)) {
+                if constexpr (Stats::enabled) {
+                    stats_.record_search(probes, true);
+                }
+                return i;
+            }
+        }
+        if constexpr (Stats::enabled) {
+            stats_.record_search(probes, false);
+        }
+        return npos;
+    }
 
-    // Hash function
-    size_t hash(const Key& key) const {
-        return std::hash<Key>{}(key) % bucket_count_;
+    // Shared body of erase for Key and heterogeneous keys : unlinks the entry from its chain and leaves a tombstone
+    template <typename K>
+    bool erase_impl(const K& key) {
+        size_t full_hash = hasher_(key);
+        size_t* link = &buckets_[bucket_for(full_hash)];
+        while (*link != npos) {
+            Entry& entry = entries_[*link];
+            if (entry.hash == full_hash && key_eq_(entry.pair->key, key)) {
+                *link = entry.next;
+                entry.pair.reset(); // destroys key and value now, the slot itself stays until compaction
+                --size_;
+                compact_if_sparse();
+                return true;
+            }
+            link = &entry.next;
+        }
+        return false;
     }
 
-    // this returns an iterator to the key value pair in the bucket
-    auto find_in_bucket(const Key& key, size_t bucket_index) {
-        auto& bucket = (*buckets)[bucket_index];
-        return std::find_if(bucket.begin(), bucket.end(),
-                            [&key](const KeyValuePair& pair) { return pair.key == key; });  // find_if(begin iterator, end iterator, predicate lambda function)
+    // Shared body of contains / find for Key and heterogeneous keys : pointer to the stored pair or nullptr
+    template <typename K>
+    KeyValuePair* find_pair(const K& key) {
+        size_t i = find_index(key, hasher_(key));
+        return i != npos ? &*entries_[i].pair : nullptr;
+    }
+    template <typename K>
+    const KeyValuePair* find_pair(const K& key) const {
+        size_t i = find_index(key, hasher_(key));
+        return i != npos ? &*entries_[i].pair : nullptr;
+    }
 
-                            /*
-                            Lambda function syntax  : [capture list] (parameters) -> return_type { function body }
-                            here capture list is key, parameters is pair, return type is bool and function body is pair.key == key 
-                            */
+    // Drop tombstones, keeping the live entries in insertion order
+    void compact() {
+        if (entries_.size() == size_) {
+            return; // no tombstone : nothing moves
+        }
+        size_t out = 0;
+        for (size_t in = 0; in < entries_.size(); ++in) {
+            if (entries_[in].pair) {
+                if (out != in) {
+                    entries_[out] = std::move(entries_[in]);
+                }
+                ++out;
+            }
+        }
+        entries_.erase(entries_.begin() + out, entries_.end());
+        front_ = 0;
     }
 
     // Resize the hash table
     void rehash(size_t new_bucket_count) {
-        auto new_buckets = new std::vector<std::list<KeyValuePair>>(new_bucket_count);
-        for (const auto& bucket : *buckets) {
-            for (const auto& pair : bucket) {
-                size_t new_index = std::hash<Key>{}(pair.key) % new_bucket_count; // hash function to determine which bucket a key-value pair goes into
-                (*new_buckets)[new_index].push_back(pair); // push_back is a function of list to add an element to the end of the list
+        /*
+            Only the bucket index is rebuilt :
+            - entries stay where they are in the dense array (tombstones apart), keys and values are not copied
+            - the cached hash gives the new bucket directly, Hash is not called again
+            - each entry is pushed at the head of its new chain
+        */
+        [[maybe_unused]] chrono::steady_clock::time_point start;
+        if constexpr (Stats::enabled) {
+            start = chrono::steady_clock::now();
+            stats_.load_factor_samples.emplace_back(size_, load_factor());
+        }
+        compact();
+        size_t bucket_count = BucketPolicy::bucket_count_for(new_bucket_count);
+        if (bucket_count == buckets_.size()) {
+            std::fill(buckets_.begin(), buckets_.end(), npos); // compaction after erase churn : no allocation
+        } else {
+            buckets_ = std::vector<size_t>(bucket_count, npos); // fresh vector : capacity matches exactly, also when shrinking
+        }
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            size_t& head = buckets_[bucket_for(entries_[i].hash)];
+            entries_[i].next = head;
+            head = i;
+        }
+        if constexpr (Stats::enabled) {
+            ++stats_.rehash_count;
+            stats_.rehash_seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    // Smallest bucket count (before policy rounding) that holds count elements without exceeding the max load factor
+    size_t buckets_needed(size_t count) const {
+        return static_cast<size_t>(std::ceil(count / max_load_factor_));
+    }
+
+    // Link (bucket head or an entry's next) that points at entry i
+    size_t* link_to(size_t i) {
+        size_t* link = &buckets_[bucket_for(entries_[i].hash)];
+        while (*link != i) {
+            link = &entries_[*link].next;
+        }
+        return link;
+    }
+
+    // Compact once tombstones outnumber live entries, so erase-heavy or reorder-heavy maps do not keep growing
+    void compact_if_sparse() {
+        if (entries_.size() > 2 * size_ + 16) {
+            rehash(buckets_.size());
+        }
+    }
+
+    // Grow the table once the load factor goes above the max load factor
+    void grow_if_needed() {
+        if (size_ > buckets_.size() * max_load_factor_) {
+            rehash(buckets_.size() * 2);
+        }
+    }
+
+    // Chain length guard, only compiled in for a reseedable Hash : true if the chain of bucket is longer than kMaxChainLength
+    //   the insert that just searched this chain brought it into cache, and the walk stops at kMaxChainLength + 1
+    bool chain_too_long(size_t bucket) const {
+        if constexpr (has_reseed<Hash>::value) {
+            size_t length = 0;
+            for (size_t i = buckets_[bucket]; i != npos && length <= kMaxChainLength; i = entries_[i].next) {
+                ++length;
             }
+            return length > kMaxChainLength;
+        } else {
+            return false;
         }
-        delete buckets;
-        buckets = new_buckets; // move is a function of vector to move the contents of one vector to another
-        bucket_count_ = new_bucket_count; // update the bucket count
     }
 
-public:
-    // 1. Default constructor
-    UnorderedMap() : size_(0), bucket_count_(10), max_load_factor_(1.0) { // default bucket count is 10 and max load factor is 1.0 
-        buckets = new std::vector<std::list<KeyValuePair>>(bucket_count_); // resize is a function of vector to resize the vector to the specified size
+    // New secret for the hash : every cached hash is recomputed and the bucket index rebuilt, entries keep their order
+    void reseed() {
+        if constexpr (has_reseed<Hash>::value) {
+            hasher_.reseed();
+            for (Entry& entry : entries_) {
+                if (entry.pair) {
+                    entry.hash = hasher_(entry.pair->key);
+                }
+            }
+            rehash(buckets_.size());
+            if constexpr (Stats::enabled) {
+                ++stats_.reseed_count;
+            }
+        }
     }
 
-    // 2. Constructor with initial bucket count
-    explicit UnorderedMap(size_t bucket_count) : size_(0), bucket_count_(bucket_count), max_load_factor_(1.0) {
-        buckets = new std::vector<std::list<KeyValuePair>>(bucket_count_);
+    // Append a new entry built from args at the end of the dense array and link it at the head of its bucket
+    // returns chain_too_long for the caller to reseed once it no longer relies on cached hashes or bucket indexes
+    template <typename... Args>
+    bool append(size_t full_hash, Args&&... args) {
+        size_t bucket = bucket_for(full_hash);
+        size_t& head = buckets_[bucket];
+        entries_.emplace_back(full_hash, head, std::forward<Args>(args)...);
+        head = entries_.size() - 1;
+        ++size_;
+        bool long_chain = chain_too_long(bucket);
+        grow_if_needed();
+        return long_chain;
     }
 
-    // 3. Insert or update a key-value pair : java equivalent of put
-    void insert_or_assign(const Key& key, const Value& value) {
-        size_t index = hash(key);
-        auto it = find_in_bucket(key, index);
-        if (it == (*buckets)[index].end()) { // if the key is not found in the bucket
-            (*buckets)[index].emplace_back(key, value); // emplace_back is a function of list to add an element to the end of the list
-            ++size_;
-            if (size_ > bucket_count_ * max_load_factor_) {
-                rehash(bucket_count_ * 2);
+    // Shared body of both try_emplace overloads : K is either const Key& or Key so the key is copied or moved exactly once
+    template <typename K, typename... Args>
+    bool try_emplace_impl(K&& key, Args&&... args) {
+        size_t full_hash = hasher_(key);
+        if (find_index(key, full_hash) != npos) {
+            return false; // Key already exists, args are left untouched
+        }
+        if (append(full_hash, std::forward<K>(key), std::forward<Args>(args)...)) {
+            reseed();
+        }
+        return true;
+    }
+
+    // Shared body of both insert_or_assign overloads
+    template <typename K, typename V>
+    void insert_or_assign_impl(K&& key, V&& value) {
+        size_t full_hash = hasher_(key);
+        size_t i = find_index(key, full_hash);
+        if (i == npos) { // if the key is not found in the bucket
+            if (append(full_hash, std::forward<K>(key), std::forward<V>(value))) {
+                reseed();
             }
         } else { // if the key is found in the bucket then update the value
-            it->value = value; // why -> ? because it is a pointer to the key value pair
+            entries_[i].pair->value = std::forward<V>(value);
+        }
+    }
+
+    // Shared body of the operator[] overloads
+    template <typename K>
+    Value& subscript_impl(K&& key) {
+        size_t full_hash = hasher_(key);
+        size_t i = find_index(key, full_hash);
+        if (i != npos) {
+            return entries_[i].pair->value;
+        }
+        // If key doesn't exist, insert a new element with a default-constructed value
+        if (append(full_hash, std::forward<K>(key))) {
+            reseed();
+        }
+        return entries_.back().pair->value; // the new entry is the last one, even if append compacted or reseeded the array
+    }
+
+    // Shared body of the upsert overloads : find-or-insert and update with a single hash and a single probe
+    //   long_chain is set when the caller has to reseed
+    template <typename K, typename Fn>
+    bool upsert_impl(K&& key, size_t full_hash, size_t bucket, Fn& fn, bool& long_chain) {
+        size_t i = find_index(key, full_hash, bucket);
+        if (i != npos) {
+            fn(entries_[i].pair->value);
+            return false;
+        }
+        long_chain |= append(full_hash, std::forward<K>(key));
+        fn(entries_.back().pair->value);
+        return true;
+    }
+
+    /*
+        Batch pipeline shared by the *_batch APIs :
+        - every key of the batch is hashed first
+        - while key i is probed, the bucket slot of key i + kPrefetchDistance and the first entry of key
+          i + kPrefetchDistance / 2 (whose bucket slot was prefetched earlier) are prefetched
+        - by the time a key is probed its bucket slot and chain head are usually in cache, so the DRAM
+          misses of consecutive keys overlap instead of being paid one after the other
+    */
+    template <typename Probe>
+    void for_each_prefetched(const std::vector<size_t>& hashes, Probe probe) const {
+        size_t n = hashes.size();
+        std::vector<size_t> bucket_of(n);
+        for (size_t i = 0; i < n; ++i) {
+            bucket_of[i] = bucket_for(hashes[i]);
+        }
+        for (size_t i = 0; i < std::min(n, kPrefetchDistance); ++i) {
+            prefetch_for_read(&buckets_[bucket_of[i]]);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (i + kPrefetchDistance < n) {
+                prefetch_for_read(&buckets_[bucket_of[i + kPrefetchDistance]]);
+            }
+            if (i + kPrefetchDistance / 2 < n) {
+                size_t head = buckets_[bucket_of[i + kPrefetchDistance / 2]];
+                if (head != npos) {
+                    prefetch_for_read(&entries_[head]);
+                }
+            }
+            probe(i, bucket_of[i]);
+        }
+    }
+
+    template <typename Keys>
+    std::vector<size_t> hash_all(const Keys& keys) const {
+        std::vector<size_t> hashes;
+        hashes.reserve(keys.size());
+        for (const auto& key : keys) {
+            hashes.push_back(hasher_(key));
+        }
+        return hashes;
+    }
+
+public:
+    /*
+        Forward iterator over the dense entry array : walks entries_ front to back and skips tombstones,
+        so a full scan is a linear memory sweep in insertion order.
+        Like std::vector iterators, they are invalidated by any insert or erase.
+    */
+    template <bool IsConst>
+    class Iterator {
+    private:
+        using EntryPtr = std::conditional_t<IsConst, const Entry*, Entry*>;
+        EntryPtr current_;
+        EntryPtr end_;
+
+        void skip_tombstones() {
+            while (current_ != end_ && !current_->pair) {
+                ++current_;
+            }
         }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = KeyValuePair;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<IsConst, const KeyValuePair*, KeyValuePair*>;
+        using reference = std::conditional_t<IsConst, const KeyValuePair&, KeyValuePair&>;
+
+        Iterator(EntryPtr current, EntryPtr end) : current_(current), end_(end) {
+            skip_tombstones();
+        }
+        operator Iterator<true>() const { // iterator -> const_iterator
+            return Iterator<true>(current_, end_);
+        }
+
+        reference operator*() const { return *current_->pair; }
+        pointer operator->() const { return &*current_->pair; }
+        Iterator& operator++() {
+            ++current_;
+            skip_tombstones();
+            return *this;
+        }
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+        bool operator==(const Iterator& other) const { return current_ == other.current_; }
+        bool operator!=(const Iterator& other) const { return current_ != other.current_; }
+    };
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    // 1. Default constructor
+    UnorderedMap() : UnorderedMap(10) {} // default bucket count is 10 (rounded up by the policy) and max load factor is 1.0 
+
+    // 2. Constructor with initial bucket count
+    explicit UnorderedMap(size_t bucket_count)
+        : buckets_(BucketPolicy::bucket_count_for(bucket_count), npos), size_(0), front_(0), max_load_factor_(1.0) {}
+
+    // 2. Constructor with the expected number of elements : UnorderedMap<K, V> map(ExpectedSize{n})
+    //    both arrays are sized for n up front, so inserting n keys never reallocates or rehashes
+    explicit UnorderedMap(ExpectedSize expected)
+        : buckets_(BucketPolicy::bucket_count_for(std::max<size_t>(expected.count, 1)), npos), size_(0), front_(0), max_load_factor_(1.0) {
+        entries_.reserve(expected.count);
+    }
+
+    // 3. Insert or update a key-value pair : java equivalent of put
+    template <typename V>
+    void insert_or_assign(const Key& key, V&& value) {
+        insert_or_assign_impl(key, std::forward<V>(value));
     }
+    template <typename V>
+    void insert_or_assign(Key&& key, V&& value) { // rvalue key : a temporary key is moved into the entry, not copied
+        insert_or_assign_impl(std::move(key), std::forward<V>(value));
+    }
+
     // 3. Insert a key-value pair 
     bool insert(const Key& key, const Value& value) {
-        size_t index = hash(key);
-        auto it = find_in_bucket(key, index);
-        if (it == (*buckets)[index].end()) {
-            (*buckets)[index].emplace_back(key, value);
-            ++size_;
-            if (size_ > bucket_count_ * max_load_factor_) {
-                rehash(bucket_count_ * 2);
-            }
-            return true;  // Insertion successful
+        return try_emplace_impl(key, value); // true if insertion successful, false if key already exists
+    }
+    bool insert(Key&& key, Value&& value) {
+        return try_emplace_impl(std::move(key), std::move(value));
+    }
+
+    // 3. Construct the value in place only if the key is absent : args are not consumed when the key already exists
+    template <typename... Args>
+    bool try_emplace(const Key& key, Args&&... args) {
+        return try_emplace_impl(key, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    bool try_emplace(Key&& key, Args&&... args) {
+        return try_emplace_impl(std::move(key), std::forward<Args>(args)...);
+    }
+
+    // 3. Construct the key-value pair in place from args at the end of the array, keep it only if its key is absent
+    template <typename... Args>
+    bool emplace(Args&&... args) {
+        entries_.emplace_back(0, npos, std::forward<Args>(args)...); // built once, directly in its final slot
+        Entry& entry = entries_.back();
+        entry.hash = hasher_(entry.pair->key);
+        if (find_index(entry.pair->key, entry.hash) != npos) { // the new entry is not linked yet, so only an older one can match
+            entries_.pop_back(); // Key already exists, the new entry is destroyed
+            return false;
+        }
+        size_t bucket = bucket_for(entry.hash);
+        entry.next = buckets_[bucket];
+        buckets_[bucket] = entries_.size() - 1;
+        ++size_;
+        bool long_chain = chain_too_long(bucket);
+        grow_if_needed();
+        if (long_chain) {
+            reseed();
         }
-        return false;  // Key already exists, insertion failed
+        return true;
     }
 
     // 4. Remove a key-value pair
     bool erase(const Key& key) {
-        size_t index = hash(key);
-        auto it = find_in_bucket(key, index);
-        if (it != (*buckets)[index].end()) { // if the key is found in the bucket
-            (*buckets)[index].erase(it); // erase is a function of list to remove an element from the list
-            --size_;
-            return true;
-        }
-        return false;
+        return erase_impl(key);
+    }
+    template <typename K, typename = enable_if_heterogeneous<K>>
+    bool erase(const K& key) {
+        return erase_impl(key);
     }
 
     // 5. Check if a key exists
-    bool contains(const Key& key) {
-        size_t index = hash(key);
-        auto it = find_in_bucket(key, index);
-        return it != (*buckets)[index].end(); // if the key is found in the bucket
+    bool contains(const Key& key) const {
+        return find_pair(key) != nullptr; // if the key is found in the bucket
+    }
+    template <typename K, typename = enable_if_heterogeneous<K>>
+    bool contains(const K& key) const {
+        return find_pair(key) != nullptr;
+    }
+
+    // 5. Find the value of a key : nullptr when the key is absent, unlike operator[] it never inserts
+    Value* find(const Key& key) {
+        KeyValuePair* pair = find_pair(key);
+        return pair ? &pair->value : nullptr;
+    }
+    const Value* find(const Key& key) const {
+        const KeyValuePair* pair = find_pair(key);
+        return pair ? &pair->value : nullptr;
+    }
+    template <typename K, typename = enable_if_heterogeneous<K>>
+    Value* find(const K& key) {
+        KeyValuePair* pair = find_pair(key);
+        return pair ? &pair->value : nullptr;
+    }
+    template <typename K, typename = enable_if_heterogeneous<K>>
+    const Value* find(const K& key) const {
+        const KeyValuePair* pair = find_pair(key);
+        return pair ? &pair->value : nullptr;
     }
 
     // 6. Get the value associated with a key also used to update the value for existing keys and insert a new key-value pair if the key doesn't exist 
-     Value& operator[](const Key& key) {
-        size_t index = hash(key);
-        auto it = find_in_bucket(key, index);
-        if (it != (*buckets)[index].end()) {
-            return it->value;
+    //    the reference is invalidated by the next insert (the dense array may reallocate)
+    Value& operator[](const Key& key) {
+        return subscript_impl(key);
+    }
+    Value& operator[](Key&& key) {
+        return subscript_impl(std::move(key));
+    }
+    // heterogeneous key : a Key is only constructed from it when the key is absent and has to be inserted
+    template <typename K, typename = enable_if_heterogeneous<K>>
+    Value& operator[](K&& key) {
+        return subscript_impl(std::forward<K>(key));
+    }
+
+    // 6. Update the value of a key in place with fn(value), inserting a value-initialized value first if the key is absent
+    //    the fused find-or-insert-and-update of group-by aggregation : returns true if the key was inserted
+    template <typename Fn>
+    bool upsert(const Key& key, Fn&& fn) {
+        size_t full_hash = hasher_(key);
+        bool long_chain = false;
+        bool inserted = upsert_impl(key, full_hash, bucket_for(full_hash), fn, long_chain);
+        if (long_chain) {
+            reseed();
         }
-        // If key doesn't exist, insert a new element with a default-constructed value
-        auto& list = (*buckets)[index];
-        list.emplace_back(key, Value()); // emplace_back is a function of list to add an element to the end of the list
-        ++size_;
-        if (size_ > bucket_count_ * max_load_factor_) {
-            rehash(bucket_count_ * 2);
+        return inserted;
+    }
+    template <typename Fn>
+    bool upsert(Key&& key, Fn&& fn) {
+        size_t full_hash = hasher_(key);
+        bool long_chain = false;
+        bool inserted = upsert_impl(std::move(key), full_hash, bucket_for(full_hash), fn, long_chain);
+        if (long_chain) {
+            reseed();
+        }
+        return inserted;
+    }
+    template <typename K, typename Fn, typename = enable_if_heterogeneous<K>>
+    bool upsert(K&& key, Fn&& fn) {
+        size_t full_hash = hasher_(key);
+        bool long_chain = false;
+        bool inserted = upsert_impl(std::forward<K>(key), full_hash, bucket_for(full_hash), fn, long_chain);
+        if (long_chain) {
+            reseed();
         }
-        return list.back().value; // back - Returns a reference to the last element in the list and value is the value
+        return inserted;
     }
 
     // 7. Get the number of elements
@@ -136,22 +792,58 @@ public:
         return size_ == 0;
     }
 
-    // 9. Clear the map
+    // 9. Clear the map : the dense array keeps its capacity for the next inserts
     void clear() {
-        for (auto& bucket : *buckets) {
-            bucket.clear();
-        }
+        entries_.clear();
+        std::fill(buckets_.begin(), buckets_.end(), npos);
         size_ = 0;
+        front_ = 0;
     }
 
     // 10. Get the number of buckets
     size_t bucket_count() const {
-        return bucket_count_;
+        return buckets_.size();
+    }
+
+    // 10. Get the number of elements in bucket n : used to inspect how evenly the policy spreads keys
+    size_t bucket_size(size_t n) const {
+        size_t count = 0;
+        for (size_t i = buckets_[n]; i != npos; i = entries_[i].next) {
+            ++count;
+        }
+        return count;
+    }
+
+    // 10. Distribution of chain lengths : histogram[n] = buckets holding n entries, computed on demand by walking the index
+    std::vector<size_t> chain_length_histogram() const {
+        std::vector<size_t> histogram;
+        for (size_t b = 0; b < buckets_.size(); ++b) {
+            size_t length = bucket_size(b);
+            if (length >= histogram.size()) {
+                histogram.resize(length + 1, 0);
+            }
+            ++histogram[length];
+        }
+        return histogram;
+    }
+
+    // 10. Length of the longest chain
+    size_t max_chain_length() const {
+        return chain_length_histogram().size() - 1;
+    }
+
+    // 10. Recorded statistics (MapStats maps only) and reset
+    const Stats& stats() const {
+        static_assert(Stats::enabled, "stats() needs the MapStats policy");
+        return stats_;
+    }
+    void reset_stats() {
+        stats_ = Stats();
     }
 
     // 11. Get the current load factor
     float load_factor() const {
-        return static_cast<float>(size_) / bucket_count_;
+        return buckets_.empty() ? 0.0f : static_cast<float>(size_) / buckets_.size();
     }
 
     // 12. Set the maximum load factor
@@ -162,81 +854,2604 @@ public:
         }
     }
 
-    // 13. Copy constructor
-    UnorderedMap(const UnorderedMap& other) : size_(other.size_), bucket_count_(other.bucket_count_), max_load_factor_(other.max_load_factor_) {
-        buckets = new std::vector<std::list<KeyValuePair>>(*other.buckets);
+    /*
+        Order operations : insertion order doubles as a recency order (front = oldest, back = newest),
+        which is what LruCache builds on. Moving an entry appends it again and leaves a tombstone,
+        tombstones are compacted like erased ones, so both operations are amortized O(1).
+    */
+    // 12. Move key to the back of the order (most recent) : returns its value at the new position, nullptr if absent
+    Value* move_to_back(const Key& key) {
+        size_t full_hash = hasher_(key);
+        size_t i = find_index(key, full_hash);
+        if (i == npos) {
+            return nullptr;
+        }
+        if (i + 1 == entries_.size()) {
+            return &entries_[i].pair->value; // already the newest
+        }
+        size_t next = entries_[i].next;
+        entries_.emplace_back(full_hash, next, std::move(*entries_[i].pair)); // moved, not copied ; may reallocate, so indices only below
+        size_t moved = entries_.size() - 1;
+        *link_to(i) = moved; // the new entry takes the old one's place in the chain
+        entries_[i].pair.reset();
+        compact_if_sparse();
+        return &entries_.back().pair->value; // still the last entry after a compaction
+    }
+
+    // 12. Remove and return the oldest element (front of the order), empty optional if the map is empty
+    std::optional<KeyValuePair> pop_front() {
+        while (front_ < entries_.size() && !entries_[front_].pair) {
+            ++front_; // tombstones before front_ are skipped once, the hint only moves forward until compaction
+        }
+        if (front_ == entries_.size()) {
+            return std::nullopt;
+        }
+        *link_to(front_) = entries_[front_].next;
+        std::optional<KeyValuePair> oldest = std::move(entries_[front_].pair);
+        entries_[front_].pair.reset();
+        ++front_;
+        --size_;
+        compact_if_sparse();
+        return oldest;
+    }
+
+    // 12. Make room for count elements : no reallocation and no rehash until the map holds more than count elements
+    void reserve(size_t count) {
+        size_t needed = buckets_needed(count);
+        if (needed > buckets_.size() || entries_.size() != size_) { // also drop tombstones, they would take slots of the reserved array
+            rehash(std::max(needed, buckets_.size()));
+        }
+        entries_.reserve(count);
+    }
+
+    // 12. Release unused memory : drops tombstones, shrinks both arrays to the current number of elements
+    void shrink_to_fit() {
+        rehash(std::max<size_t>(buckets_needed(size_), 1));
+        entries_.shrink_to_fit();
+    }
+
+    // 12. Get the number of elements the map can hold before the dense array reallocates
+    size_t capacity() const {
+        return entries_.capacity() - (entries_.size() - size_); // tombstones use slots until the next compaction
+    }
+
+    // 13. Iteration in insertion order : for (auto& [key, value] : map) or for (auto& pair : map)
+    iterator begin() { return iterator(entries_.data() + front_, entries_.data() + entries_.size()); }
+    iterator end() { return iterator(entries_.data() + entries_.size(), entries_.data() + entries_.size()); }
+    const_iterator begin() const { return const_iterator(entries_.data() + front_, entries_.data() + entries_.size()); }
+    const_iterator end() const { return const_iterator(entries_.data() + entries_.size(), entries_.data() + entries_.size()); }
+
+    // 13. Call fn(key, value) for every element in insertion order
+    template <typename Fn>
+    void for_each(Fn fn) {
+        for (size_t i = front_; i < entries_.size(); ++i) {
+            Entry& entry = entries_[i];
+            if (entry.pair) {
+                fn(static_cast<const Key&>(entry.pair->key), entry.pair->value);
+            }
+        }
+    }
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        for (size_t i = front_; i < entries_.size(); ++i) {
+            const Entry& entry = entries_[i];
+            if (entry.pair) {
+                fn(entry.pair->key, entry.pair->value);
+            }
+        }
+    }
+
+    // 14. Insert every pair of items whose key is absent (like insert), returns how many were inserted
+    //     the table is grown once up front, so the whole batch is inserted without an intermediate rehash
+    size_t insert_batch(const std::vector<std::pair<Key, Value>>& items) {
+        reserve(size_ + items.size());
+        std::vector<size_t> hashes(items.size());
+        for (size_t i = 0; i < items.size(); ++i) {
+            hashes[i] = hasher_(items[i].first);
+        }
+        size_t inserted = 0;
+        bool long_chain = false;
+        for_each_prefetched(hashes, [&](size_t i, size_t bucket) {
+            if (find_index(items[i].first, hashes[i], bucket) == npos) {
+                long_chain |= append(hashes[i], items[i].first, items[i].second); // no rehash : capacity was planned above
+                ++inserted;
+            }
+        });
+        if (long_chain) {
+            reseed(); // after the pipeline : the batch hashes are stale once the hash is reseeded
+        }
+        return inserted;
+    }
+
+    // 14. Look up every key : values[i] points to the value of keys[i] or is nullptr, returns the number of hits
+    //     the pointers are invalidated by the next insert or erase
+    size_t find_batch(const std::vector<Key>& keys, std::vector<const Value*>& values) const {
+        std::vector<size_t> hashes = hash_all(keys);
+        values.assign(keys.size(), nullptr);
+        size_t hits = 0;
+        for_each_prefetched(hashes, [&](size_t i, size_t bucket) {
+            size_t index = find_index(keys[i], hashes[i], bucket);
+            if (index != npos) {
+                values[i] = &entries_[index].pair->value;
+                ++hits;
+            }
+        });
+        return hits;
+    }
+
+    // 14. Check every key : found[i] tells whether keys[i] is in the map, returns the number of hits
+    size_t contains_batch(const std::vector<Key>& keys, std::vector<bool>& found) const {
+        std::vector<size_t> hashes = hash_all(keys);
+        found.assign(keys.size(), false);
+        size_t hits = 0;
+        for_each_prefetched(hashes, [&](size_t i, size_t bucket) {
+            if (find_index(keys[i], hashes[i], bucket) != npos) {
+                found[i] = true;
+                ++hits;
+            }
+        });
+        return hits;
+    }
+
+    // 14. upsert every key with fn, returns the number of keys inserted
+    /*
+        - the batch is cut in chunks of kUpsertChunk keys
+        - before a chunk, the table grows as if the whole chunk were new keys, so no rehash happens inside a chunk
+          and the bucket indexes prefetched by the pipeline stay valid
+        - a chunk of repeated keys (the usual group-by case) therefore costs at most one early doubling
+    */
+    template <typename Fn>
+    size_t upsert_batch(const std::vector<Key>& keys, Fn fn) {
+        constexpr size_t kUpsertChunk = 256;
+        std::vector<size_t> hashes;
+        size_t inserted = 0;
+        for (size_t first = 0; first < keys.size(); first += kUpsertChunk) {
+            size_t last = std::min(keys.size(), first + kUpsertChunk);
+            hashes.clear();
+            for (size_t i = first; i < last; ++i) {
+                hashes.push_back(hasher_(keys[i]));
+            }
+            while (size_ + hashes.size() > buckets_.size() * max_load_factor_) {
+                rehash(buckets_.size() * 2);
+            }
+            bool long_chain = false;
+            for_each_prefetched(hashes, [&](size_t i, size_t bucket) {
+                inserted += upsert_impl(keys[first + i], hashes[i], bucket, fn, long_chain);
+            });
+            if (long_chain) {
+                reseed(); // between chunks : the next chunk is hashed with the new secret
+            }
+        }
+        return inserted;
     }
 
-    // 14. Copy assignment operator
+    // 15. Copy constructor
+    /*
+        - std::vector copy constructor copies the dense entry array and the bucket index.
+        - Each Entry copy copies its cached hash, its chain link and its KeyValuePair.
+        - The Key and Value objects within each KeyValuePair will have their copy constructors called as well.
+        - The bucket index is a vector of size_t : it is copied as one block.
+        - No separate memcpy path for trivially copyable entries (e.g. UnorderedMap<int, int>) : std::vector only
+          hands out storage that already holds live elements, and Entry has no default constructor, so a memcpy
+          would first need a pass constructing every entry. The element loop is already a plain copy of
+          trivially copyable structs, which the compiler turns into wide moves without calling any constructor.
+    */
+    UnorderedMap(const UnorderedMap& other)
+        : entries_(other.entries_), buckets_(other.buckets_), size_(other.size_), front_(other.front_), max_load_factor_(other.max_load_factor_),
+          hasher_(other.hasher_), key_eq_(other.key_eq_), stats_(other.stats_) {}
+
+    // 16. Copy assignment operator
     UnorderedMap& operator=(const UnorderedMap& other) {
         if (this != &other) {
-            delete buckets;
+            entries_ = other.entries_;
+            buckets_ = other.buckets_;
             size_ = other.size_;
-            bucket_count_ = other.bucket_count_;
+            front_ = other.front_;
             max_load_factor_ = other.max_load_factor_;
-            /*
-                - std::vector copy constructor will be called when we create a new vector from the other vector.
-                - This will, in turn, call the copy constructor of each std::list it contains.
-                - Each std::list copy constructor will then copy all the KeyValuePair objects it contains.
-                - The Key and Value objects within each KeyValuePair will have their copy constructors called as well.
-
-            */
-            buckets = new std::vector<std::list<KeyValuePair>>(*other.buckets); // This dereferences the buckets pointer of the other
-
+            hasher_ = other.hasher_;
+            key_eq_ = other.key_eq_;
+            stats_ = other.stats_;
         }
         return *this;
     }
 
-    // Move constructor
-    UnorderedMap(UnorderedMap&& other) noexcept : size_(other.size_), bucket_count_(other.bucket_count_), max_load_factor_(other.max_load_factor_) {
-        buckets = other.buckets;
-        other.buckets = nullptr;
+    // Move constructor : steals both arrays, the moved-from map may only be destroyed or assigned to
+    UnorderedMap(UnorderedMap&& other) noexcept
+        : entries_(std::move(other.entries_)), buckets_(std::move(other.buckets_)), size_(other.size_), front_(other.front_),
+          max_load_factor_(other.max_load_factor_), hasher_(std::move(other.hasher_)), key_eq_(std::move(other.key_eq_)),
+          stats_(std::move(other.stats_)) {
         other.size_ = 0;
-        other.bucket_count_ = 0;
+        other.front_ = 0;
     }
 
     // Move assignment operator
     UnorderedMap& operator=(UnorderedMap&& other) noexcept {
         if (this != &other) {
-            delete buckets;
+            entries_ = std::move(other.entries_);
+            buckets_ = std::move(other.buckets_);
             size_ = other.size_;
-            bucket_count_ = other.bucket_count_;
+            front_ = other.front_;
             max_load_factor_ = other.max_load_factor_;
-            buckets = other.buckets;
-            other.buckets = nullptr;
+            hasher_ = std::move(other.hasher_);
+            key_eq_ = std::move(other.key_eq_);
+            stats_ = std::move(other.stats_);
             other.size_ = 0;
-            other.bucket_count_ = 0;
+            other.front_ = 0;
         }
         return *this;
     }
 
     // Destructor
-    ~UnorderedMap() {
-        /*
-            - std::vector destructor will be automatically called when we delete buckets. 
-            - This vector destructor will, in turn, call the destructor of each std::list it contains.
-            - Each std::list destructor will then delete all the KeyValuePair objects it contains.
-            - The Key and Value objects within each KeyValuePair will have their destructors called as well.
-        */
-        delete buckets;
-    }
+    /*
+        - std::vector destructors run automatically for entries_ and buckets_.
+        - Destroying entries_ destroys each Entry, and with it the Key and Value of every live KeyValuePair.
+    */
+    ~UnorderedMap() = default;
 };
 
 
-int main() {
-    /* Logic for Unordered Map implementation:
-    UnorderedMap
+/*
+    CountingMap : group-by counter, key -> number of occurrences
+    - add is one upsert : hash once, probe once, increment in place (no separate find then insert)
+    - add_all counts a whole batch through the prefetching upsert_batch pipeline
+*/
+template <typename Key, typename Count = uint64_t, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+class CountingMap {
+private:
+    UnorderedMap<Key, Count, Hash, KeyEqual> counts_;
+    Count total_ = 0;
+
+public:
+    // 1. Add n occurrences of key, returns its new count
+    Count add(const Key& key, Count n = 1) {
+        Count updated = 0;
+        counts_.upsert(key, [n, &updated](Count& count) { updated = count += n; });
+        total_ += n;
+        return updated;
+    }
+
+    // 2. Add one occurrence of every key of the batch, returns the number of keys seen for the first time
+    size_t add_all(const std::vector<Key>& keys) {
+        total_ += static_cast<Count>(keys.size());
+        return counts_.upsert_batch(keys, [](Count& count) { ++count; });
+    }
+
+    // 3. Get the count of a key, 0 if it was never added
+    Count count(const Key& key) const {
+        const Count* found = counts_.find(key);
+        return found ? *found : 0;
+    }
+
+    // 4. Forget a key, returns its count
+    Count erase(const Key& key) {
+        Count removed = count(key);
+        counts_.erase(key);
+        total_ -= removed;
+        return removed;
+    }
+
+    // 5. Get the k most frequent keys, most frequent first
+    std::vector<std::pair<Key, Count>> top(size_t k) const {
+        std::vector<std::pair<Key, Count>> result;
+        result.reserve(counts_.size());
+        counts_.for_each([&result](const Key& key, const Count& count) { result.emplace_back(key, count); });
+        k = std::min(k, result.size());
+        std::partial_sort(result.begin(), result.begin() + k, result.end(),
+                          [](const auto& a, const auto& b) { return a.second > b.second; });
+        result.resize(k);
+        return result;
+    }
+
+    // 6. Visit every key with its count
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        counts_.for_each(fn);
+    }
+
+    // 7. Get the number of distinct keys , the sum of all counts
+    size_t size() const {
+        return counts_.size();
+    }
+    Count total() const {
+        return total_;
+    }
+
+    // 8. Remove everything (the table keeps its capacity)
+    void clear() {
+        counts_.clear();
+        total_ = 0;
+    }
+};
+
+
+/*
+    UnorderedMultiMap : key -> several values, the values of one key stored as one contiguous run
+    - the index is an UnorderedMap<Key, Run> ; every run lives in a single shared value array (the arena)
+    - a full run doubles : it grows in place when it is the last run of the arena, otherwise it moves to the end
+    - the space left behind by moved or erased runs is reclaimed by compacting the arena once it exceeds the live values
+    - equal_range is a pointer pair over the run : a group is scanned as a plain array, no node hopping
+    Value must be default constructible and move assignable. Ranges are invalidated by the next insert or erase.
+*/
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+class UnorderedMultiMap {
+public:
+    // The values of one key
+    struct ValueRun {
+        const Value* first;
+        const Value* last;
+        const Value* begin() const { return first; }
+        const Value* end() const { return last; }
+        size_t size() const { return last - first; }
+        bool empty() const { return first == last; }
+    };
+
+private:
+    struct Run {
+        size_t offset = 0;
+        size_t length = 0;
+        size_t capacity = 0;
+    };
+
+    static constexpr size_t kFirstRunCapacity = 2;
+
+    UnorderedMap<Key, Run, Hash, KeyEqual> index_;
+    std::vector<Value> arena_;
+    size_t size_ = 0;     // live values
+    size_t garbage_ = 0;  // arena slots owned by no run
+
+    // Make room for one more value in run, moving or growing it in the arena
+    void grow_run(Run& run) {
+        size_t capacity = std::max(kFirstRunCapacity, run.capacity * 2);
+        if (run.capacity != 0 && run.offset + run.capacity == arena_.size()) {
+            arena_.resize(run.offset + capacity); // last run of the arena : extend it in place
+        } else {
+            size_t offset = arena_.size();
+            arena_.resize(offset + capacity);
+            std::move(arena_.begin() + run.offset, arena_.begin() + run.offset + run.length, arena_.begin() + offset);
+            garbage_ += run.capacity;
+            run.offset = offset;
+        }
+        run.capacity = capacity;
+    }
+
+    // Rebuild the arena with every run packed back to back, in index order
+    void compact() {
+        std::vector<Value> packed;
+        packed.reserve(size_);
+        index_.for_each([this, &packed](const Key&, Run& run) {
+            size_t offset = packed.size();
+            std::move(arena_.begin() + run.offset, arena_.begin() + run.offset + run.length, std::back_inserter(packed));
+            run.offset = offset;
+            run.capacity = run.length;
+        });
+        arena_ = std::move(packed);
+        garbage_ = 0;
+    }
+
+    void compact_if_sparse() {
+        if (garbage_ > size_ + 64) {
+            compact();
+        }
+    }
+
+public:
+    // 1. Insert a value for key, after the values it already has
+    template <typename V>
+    void insert(const Key& key, V&& value) {
+        Run* run = nullptr;
+        index_.upsert(key, [&run](Run& r) { run = &r; });
+        if (run->length == run->capacity) {
+            grow_run(*run);
+        }
+        arena_[run->offset + run->length++] = std::forward<V>(value);
+        ++size_;
+        compact_if_sparse();
+    }
+
+    // 2. Get the values of a key as one contiguous range (empty if the key is absent)
+    ValueRun equal_range(const Key& key) const {
+        const Run* run = index_.find(key);
+        if (run == nullptr) {
+            return {nullptr, nullptr};
+        }
+        const Value* first = arena_.data() + run->offset;
+        return {first, first + run->length};
+    }
+
+    // 3. Get the number of values of a key , check if a key exists
+    size_t count(const Key& key) const {
+        const Run* run = index_.find(key);
+        return run ? run->length : 0;
+    }
+    bool contains(const Key& key) const {
+        return index_.contains(key);
+    }
+
+    // 4. Remove a key and all its values, returns the number of values removed
+    size_t erase(const Key& key) {
+        Run* run = index_.find(key);
+        if (run == nullptr) {
+            return 0;
+        }
+        size_t removed = run->length;
+        std::fill(arena_.begin() + run->offset, arena_.begin() + run->offset + run->length, Value()); // release what the values own now
+        garbage_ += run->capacity;
+        size_ -= removed;
+        index_.erase(key);
+        compact_if_sparse();
+        return removed;
+    }
+
+    // 5. Visit every group : fn(key, first value, number of values)
+    template <typename Fn>
+    void for_each_group(Fn fn) const {
+        index_.for_each([this, &fn](const Key& key, const Run& run) { fn(key, arena_.data() + run.offset, run.length); });
+    }
+
+    // 6. Get the number of values , the number of distinct keys
+    size_t size() const {
+        return size_;
+    }
+    size_t key_count() const {
+        return index_.size();
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // 7. Remove everything
+    void clear() {
+        index_.clear();
+        arena_.clear();
+        size_ = 0;
+        garbage_ = 0;
+    }
+};
+
+
+// Counters exported by the caches for monitoring
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t insertions = 0;
+    uint64_t evictions = 0;
+    uint64_t rejections = 0; // admission filter turned a new entry away (TinyLfuCache only)
+
+    double hit_ratio() const {
+        uint64_t lookups = hits + misses;
+        return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+    }
+};
+
+// Default entry size for LruCache : the in-place size of key and value (heap memory they own is not counted)
+struct ShallowEntrySize {
+    template <typename Key, typename Value>
+    size_t operator()(const Key&, const Value&) const {
+        return sizeof(Key) + sizeof(Value);
+    }
+};
+
+/*
+    LruCache : least recently used cache with a byte budget, built directly on UnorderedMap
+    - the map's insertion order is the recency order : front = least recently used, back = most recently used
+    - a hit moves the entry to the back of the map (move_to_back) : one lookup, no allocation once the map is warm
+    - eviction pops the front of the map until the cached bytes fit the budget
+    - no separate list, so no second lookup and no second allocation per touch
+    - entry sizes come from Sizer(key, value), e.g. a lambda adding string capacities
+*/
+template <typename Key, typename Value, typename Sizer = ShallowEntrySize, typename Hash = std::hash<Key>>
+class LruCache {
+private:
+    UnorderedMap<Key, Value, Hash> map_;
+    size_t max_bytes_;
+    size_t bytes_;
+    Sizer sizer_;
+    CacheStats stats_;
+
+    void evict_to_budget() {
+        while (bytes_ > max_bytes_ && !map_.empty()) {
+            std::optional<typename UnorderedMap<Key, Value, Hash>::KeyValuePair> oldest = map_.pop_front();
+            bytes_ -= sizer_(oldest->key, oldest->value);
+            ++stats_.evictions;
+        }
+    }
+
+public:
+    // 1. Constructor with the byte budget
+    explicit LruCache(size_t max_bytes, Sizer sizer = Sizer()) : max_bytes_(max_bytes), bytes_(0), sizer_(sizer) {}
+
+    // 2. Get the value of key and mark it most recently used : nullptr on a miss
+    //    the pointer is invalidated by the next get/put/erase
+    Value* get(const Key& key) {
+        Value* value = map_.move_to_back(key);
+        if (value != nullptr) {
+            ++stats_.hits;
+        } else {
+            ++stats_.misses;
+        }
+        return value;
+    }
+
+    // 3. Get the value of key without touching its recency or the counters
+    const Value* peek(const Key& key) const {
+        return map_.find(key);
+    }
+
+    // 4. Insert or replace the value of key, mark it most recently used, then evict down to the byte budget
+    //    an entry larger than the whole budget is evicted right away
+    void put(const Key& key, Value value) {
+        if (Value* existing = map_.move_to_back(key)) {
+            bytes_ -= sizer_(key, *existing);
+            *existing = std::move(value);
+            bytes_ += sizer_(key, *existing);
+        } else {
+            bytes_ += sizer_(key, value);
+            map_.try_emplace(key, std::move(value));
+            ++stats_.insertions;
+        }
+        evict_to_budget();
+    }
+
+    // 5. Remove key from the cache
+    bool erase(const Key& key) {
+        const Value* value = map_.find(key);
+        if (value == nullptr) {
+            return false;
+        }
+        bytes_ -= sizer_(key, *value);
+        return map_.erase(key);
+    }
+
+    // 6. Monitoring : counters, number of entries, bytes in use and byte budget
+    const CacheStats& stats() const { return stats_; }
+    size_t size() const { return map_.size(); }
+    size_t bytes() const { return bytes_; }
+    size_t max_bytes() const { return max_bytes_; }
+
+    // 7. Change the byte budget, evicting least recently used entries if it shrinks
+    void set_max_bytes(size_t max_bytes) {
+        max_bytes_ = max_bytes;
+        evict_to_budget();
+    }
+};
+
+
+// Shard of a hash for the sharded maps below : remixed so it does not correlate with the top bits the
+// power-of-two bucket policy uses, otherwise every key of a shard would land in the same few buckets
+inline size_t shard_index(uint64_t hash, size_t shard_mask) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull; // murmur3 finalizer step
+    hash ^= hash >> 33;
+    return static_cast<size_t>(hash & shard_mask);
+}
+
+/*
+    ConcurrentUnorderedMap : thread safe map made of N independent UnorderedMap shards
+    - a key always lives in shard (mixed hash & (N - 1)), so threads touching different shards never contend
+    - each shard has its own reader-writer lock : lookups take it shared, so readers of a shard run in parallel
+    - values are returned by copy, a reference could not outlive the shard lock
+    - compute_if_absent / update run the whole read-modify-write under one shard lock, so they are atomic per key
+*/
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class ConcurrentUnorderedMap {
+private:
+    // alignas(64) : each shard on its own cache line, so locking one shard does not invalidate its neighbours
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        UnorderedMap<Key, Value, Hash> map;
+    };
+
+    std::vector<Shard> shards_;
+    size_t shard_mask_;
+    Hash hasher_;
+
+    Shard& shard_for(const Key& key) {
+        return shards_[shard_index(hasher_(key), shard_mask_)];
+    }
+    const Shard& shard_for(const Key& key) const {
+        return const_cast<ConcurrentUnorderedMap*>(this)->shard_for(key);
+    }
+
+public:
+    // 1. Constructor : shard count is rounded up to a power of two, default 64 (enough for 64 threads to rarely collide)
+    explicit ConcurrentUnorderedMap(size_t shard_count = 64)
+        : shards_(PowerOfTwoBucketPolicy::bucket_count_for(shard_count)), shard_mask_(shards_.size() - 1) {}
+
+    ConcurrentUnorderedMap(const ConcurrentUnorderedMap&) = delete; // the locks are not copyable
+    ConcurrentUnorderedMap& operator=(const ConcurrentUnorderedMap&) = delete;
+
+    // 2. Insert a key-value pair, false if the key already exists
+    bool insert(const Key& key, const Value& value) {
+        Shard& shard = shard_for(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.insert(key, value);
+    }
+
+    // 3. Insert or update a key-value pair
+    void insert_or_assign(const Key& key, const Value& value) {
+        Shard& shard = shard_for(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.map.insert_or_assign(key, value);
+    }
+
+    // 4. Remove a key-value pair
+    bool erase(const Key& key) {
+        Shard& shard = shard_for(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.erase(key);
+    }
+
+    // 5. Check if a key exists : shared lock, runs in parallel with other readers of the shard
+    bool contains(const Key& key) const {
+        const Shard& shard = shard_for(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.contains(key);
+    }
+
+    // 6. Get a copy of the value of a key, empty optional if the key is absent
+    std::optional<Value> find(const Key& key) const {
+        const Shard& shard = shard_for(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        const Value* value = shard.map.find(key);
+        return value ? std::optional<Value>(*value) : std::nullopt;
+    }
+
+    // 7. Return the value of key, calling make() to create it first if the key is absent
+    //    make() runs at most once per key even when several threads race on the same missing key
+    template <typename MakeValue>
+    Value compute_if_absent(const Key& key, MakeValue make) {
+        Shard& shard = shard_for(key);
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex); // fast path : key already present, no exclusive lock
+            if (const Value* value = shard.map.find(key)) {
+                return *value;
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        if (const Value* value = shard.map.find(key)) { // another thread may have inserted it between the two locks
+            return *value;
+        }
+        Value& value = shard.map[key] = make();
+        return value;
+    }
+
+    // 8. Apply fn(value) to the value of key under the shard lock, false if the key is absent
+    template <typename Fn>
+    bool update(const Key& key, Fn fn) {
+        Shard& shard = shard_for(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        Value* value = shard.map.find(key);
+        if (value == nullptr) {
+            return false;
+        }
+        fn(*value);
+        return true;
+    }
+
+    // 9. Get the number of elements : shards are summed one at a time, so the result is only a snapshot under concurrent writes
+    size_t size() const {
+        size_t total = 0;
+        for (const Shard& shard : shards_) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            total += shard.map.size();
+        }
+        return total;
+    }
+
+    // 10. Get the number of shards
+    size_t shard_count() const {
+        return shards_.size();
+    }
+};
+
+
+/*
+    PartitionedMap : map split by hash into independent UnorderedMap partitions, for bulk jobs run on several threads
+    Both bulk operations run in two phases, and no lock is ever taken :
+    - scatter : the input is cut into slices (slices of the item array, or one slice per source map), each thread
+      sorts its slices into one list per partition
+    - build : each thread takes whole partitions and fills them from the lists of every slice, in slice order
+    A partition is only ever written by one thread, and equal keys always meet in the same partition, so the
+    result (including which value is kept or how duplicates are combined) is the same as a serial run.
+*/
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+class PartitionedMap {
+public:
+    using Map = UnorderedMap<Key, Value, Hash, KeyEqual>;
+
+private:
+    std::vector<Map> partitions_;
+    size_t partition_mask_;
+    Hash hasher_;
+
+    size_t partition_of(const Key& key) const {
+        return shard_index(hasher_(key), partition_mask_);
+    }
+
+    // Runs fn(worker) on threads workers and rethrows the first exception once they are all joined
+    template <typename Fn>
+    static void run_workers(size_t threads, Fn fn) {
+        std::vector<std::thread> workers;
+        std::vector<std::exception_ptr> errors(threads);
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&fn, &errors, t] {
+                try {
+                    fn(t);
+                } catch (...) {
+                    errors[t] = std::current_exception();
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        for (const std::exception_ptr& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    // Phase 2 shared by build and merge : scattered[slice][partition] lists the pairs of one slice for one partition
+    template <typename Pair, typename Combine>
+    void fill_partitions(const std::vector<std::vector<std::vector<const Pair*>>>& scattered, size_t threads, Combine& combine) {
+        std::atomic<size_t> next_partition{0};
+        run_workers(threads, [&](size_t) {
+            for (size_t p = next_partition++; p < partitions_.size(); p = next_partition++) {
+                Map& partition = partitions_[p];
+                size_t incoming = 0;
+                for (const auto& slice : scattered) {
+                    incoming += slice[p].size();
+                }
+                partition.reserve(partition.size() + incoming);
+                for (const auto& slice : scattered) {
+                    for (const Pair* pair : slice[p]) {
+                        const auto& [key, value] = *pair;
+                        if (!partition.try_emplace(key, value)) {
+                            combine(*partition.find(key), value);
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+public:
+    // 1. Constructor with the number of partitions (rounded up to a power of two)
+    explicit PartitionedMap(size_t partition_count = 64)
+        : partitions_(PowerOfTwoBucketPolicy::bucket_count_for(partition_count)), partition_mask_(partitions_.size() - 1) {}
+
+    // 2. Parallel bulk insert : when a key is already present, combine(existing value, new value) is applied
+    template <typename Combine>
+    void build(const std::vector<std::pair<Key, Value>>& items, size_t threads, Combine combine) {
+        threads = std::max<size_t>(threads, 1);
+        size_t slice_size = (items.size() + threads - 1) / threads;
+        std::vector<std::vector<std::vector<const std::pair<Key, Value>*>>> scattered(
+            threads, std::vector<std::vector<const std::pair<Key, Value>*>>(partitions_.size()));
+        run_workers(threads, [&](size_t t) {
+            size_t last = std::min(items.size(), (t + 1) * slice_size);
+            for (size_t i = t * slice_size; i < last; ++i) {
+                scattered[t][partition_of(items[i].first)].push_back(&items[i]);
+            }
+        });
+        fill_partitions(scattered, threads, combine);
+    }
+    // first value wins, like insert
+    void build(const std::vector<std::pair<Key, Value>>& items, size_t threads) {
+        build(items, threads, [](Value&, const Value&) {});
+    }
+
+    // 3. Parallel merge of several maps : equal keys are combined with combine(existing value, value of a later map)
+    template <typename Combine>
+    void merge(const std::vector<const Map*>& maps, size_t threads, Combine combine) {
+        using Pair = typename Map::KeyValuePair;
+        threads = std::max<size_t>(threads, 1);
+        std::vector<std::vector<std::vector<const Pair*>>> scattered(maps.size(), std::vector<std::vector<const Pair*>>(partitions_.size()));
+        std::atomic<size_t> next_map{0};
+        run_workers(threads, [&](size_t) {
+            for (size_t m = next_map++; m < maps.size(); m = next_map++) {
+                for (const Pair& pair : *maps[m]) {
+                    scattered[m][partition_of(pair.key)].push_back(&pair);
+                }
+            }
+        });
+        fill_partitions(scattered, threads, combine);
+    }
+
+    // 4. Find the value of a key : nullptr when the key is absent
+    const Value* find(const Key& key) const {
+        return partitions_[partition_of(key)].find(key);
+    }
+    Value* find(const Key& key) {
+        return partitions_[partition_of(key)].find(key);
+    }
+
+    // 5. Check if a key exists
+    bool contains(const Key& key) const {
+        return partitions_[partition_of(key)].contains(key);
+    }
+
+    // 6. Insert a single key-value pair (serial)
+    bool insert(const Key& key, const Value& value) {
+        return partitions_[partition_of(key)].insert(key, value);
+    }
+
+    // 7. Get the number of elements
+    size_t size() const {
+        size_t total = 0;
+        for (const Map& partition : partitions_) {
+            total += partition.size();
+        }
+        return total;
+    }
+
+    // 8. Get the number of partitions , a partition (each one is an independent UnorderedMap)
+    size_t partition_count() const {
+        return partitions_.size();
+    }
+    const Map& partition(size_t index) const {
+        return partitions_[index];
+    }
+
+    // 9. Visit every key-value pair, partition by partition
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        for (const Map& partition : partitions_) {
+            partition.for_each(fn);
+        }
+    }
+};
+
+
+/*
+    NodePool : growable pool of fixed-size blocks, a list of MemoryPool chunks without the fixed capacity
+    - when every chunk is exhausted a new MemoryPool twice as large as the last one is added
+    - allocate / deallocate use the chunks' free lists : O(1) to allocate, no call to the global allocator once warmed up
+    - deallocate finds the owning chunk by address : chunks double, so there are only a few dozen to check at most
+    - chunks are only returned when the pool is destroyed or release() is called, all at once
+    - not thread safe : the owner serializes access (RcuUnorderedMap uses one pool per shard, under the shard mutex)
+*/
+class NodePool {
+private:
+    size_t block_size_;
+    size_t next_chunk_blocks_;
+    std::vector<std::unique_ptr<MemoryPool>> chunks_;
+    std::vector<MemoryPool*> with_free_; // every chunk with a free block, once each : allocate takes from the top
+    size_t capacity_;  // blocks in all chunks
+    size_t in_use_;
+
+    void grow() {
+        chunks_.push_back(std::make_unique<MemoryPool>(block_size_, next_chunk_blocks_));
+        with_free_.push_back(chunks_.back().get());
+        capacity_ += next_chunk_blocks_;
+        next_chunk_blocks_ *= 2;
+    }
+
+public:
+    // 1. Constructor : block_size is rounded up so that every block is suitably aligned for any type
+    explicit NodePool(size_t block_size, size_t first_chunk_blocks = 64)
+        : block_size_((std::max(block_size, sizeof(void*)) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) *
+                      alignof(std::max_align_t)),
+          next_chunk_blocks_(std::max<size_t>(first_chunk_blocks, 1)), capacity_(0), in_use_(0) {}
+
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    // 2. Allocate a block, growing the pool if needed
+    void* allocate() {
+        if (with_free_.empty()) {
+            grow();
+        }
+        MemoryPool* chunk = with_free_.back();
+        void* block = chunk->allocate();
+        if (chunk->exhausted()) {
+            with_free_.pop_back(); // pushed back by the deallocate that frees one of its blocks
+        }
+        ++in_use_;
+        return block;
+    }
+
+    // 3. Give a block back to the free list of its chunk
+    void deallocate(void* ptr) {
+        if (ptr == nullptr) return;
+        for (auto it = chunks_.rbegin(); it != chunks_.rend(); ++it) { // newest (largest) chunk first
+            MemoryPool& chunk = **it;
+            if (chunk.owns(ptr)) {
+                if (chunk.exhausted()) {
+                    with_free_.push_back(&chunk); // it has a free block again
+                }
+                chunk.deallocate(ptr);
+                --in_use_;
+                return;
+            }
+        }
+        throw std::invalid_argument("NodePool: pointer not from this pool");
+    }
+
+    // 4. Construct / destroy an object in a block
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "NodePool: over-aligned type");
+        void* block = allocate();
+        try {
+            return new (block) T(std::forward<Args>(args)...);
+        } catch (...) {
+            deallocate(block);
+            throw;
+        }
+    }
+
+    template <typename T>
+    void destroy(T* object) {
+        if (object == nullptr) return;
+        object->~T();
+        deallocate(object);
+    }
+
+    // 5. Free every chunk at once : only valid when no block is in use
+    void release() {
+        if (in_use_ != 0) {
+            throw std::logic_error("NodePool: release with blocks still in use");
+        }
+        with_free_.clear();
+        chunks_.clear();
+        capacity_ = 0;
+    }
+
+    // 6. Get the block size , the number of blocks owned and in use
+    size_t block_size() const {
+        return block_size_;
+    }
+    size_t capacity() const {
+        return capacity_;
+    }
+    size_t in_use() const {
+        return in_use_;
+    }
+};
+
+
+/*
+    EpochDomain : epoch based reclamation shared by every RcuUnorderedMap
+    - each reader thread owns a slot; while reading, the slot holds the global epoch it saw on entry, otherwise 0
+    - a writer that unlinks a node or table retires it with tag = global epoch, then bumps the global epoch
+    - a retired object is freed once every active slot holds an epoch newer than its tag :
+      those readers entered after the unlink and cannot reach the object
+    - entering is one store and a fence, leaving is one store, so readers never wait on writers
+*/
+class EpochDomain {
+private:
+    static constexpr size_t kMaxThreads = 256;
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0}; // 0 = not inside a read section
+        std::atomic<bool> in_use{false};
+    };
+
+    // Gives the slot back when its thread exits
+    struct SlotHandle {
+        Slot* slot = nullptr;
+        ~SlotHandle() {
+            if (slot != nullptr) {
+                slot->in_use.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    Slot slots_[kMaxThreads];
+    std::atomic<uint64_t> global_epoch_{1};
+
+    Slot& slot_for_this_thread() {
+        thread_local SlotHandle handle;
+        if (handle.slot == nullptr) {
+            for (Slot& slot : slots_) {
+                bool expected = false;
+                if (slot.in_use.compare_exchange_strong(expected, true)) {
+                    handle.slot = &slot;
+                    break;
+                }
+            }
+            if (handle.slot == nullptr) {
+                throw std::runtime_error("EpochDomain: too many concurrent reader threads");
+            }
+        }
+        return *handle.slot;
+    }
+
+public:
+    static EpochDomain& instance() {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    // RAII read section : nodes and tables reachable inside it are not freed until it ends
+    class ReadGuard {
+    private:
+        Slot& slot_;
+
+    public:
+        explicit ReadGuard(EpochDomain& domain) : slot_(domain.slot_for_this_thread()) {
+            // acquire : the epoch published is never older than the retirements this reader can already observe
+            slot_.epoch.store(domain.global_epoch_.load(std::memory_order_acquire), std::memory_order_relaxed);
+            // pairs with the fence in oldest_active_epoch : either the scan sees this epoch,
+            // or every load this reader makes afterwards sees the unlink that preceded the scan
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        ~ReadGuard() {
+            slot_.epoch.store(0, std::memory_order_release);
+        }
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+    };
+
+    // Called after an object has been unlinked : returns the tag to retire it with
+    uint64_t retire_tag() {
+        return global_epoch_.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    // Objects with a tag below this value are unreachable by every reader
+    uint64_t oldest_active_epoch() const {
+        std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the fence in ReadGuard
+        uint64_t oldest = UINT64_MAX;
+        for (const Slot& slot : slots_) {
+            uint64_t epoch = slot.epoch.load(std::memory_order_seq_cst);
+            if (epoch != 0 && epoch < oldest) {
+                oldest = epoch;
+            }
+        }
+        return oldest;
+    }
+};
+
+/*
+    RcuUnorderedMap : concurrent map for read-mostly workloads
+    - readers take no lock at all : they enter an epoch read section and walk immutable nodes
+    - writers serialize on a per shard mutex and never modify a node a reader can see :
+      an update publishes a new node in place of the old one, an erase unlinks the node
+    - growing builds a complete new bucket table and publishes it with one atomic store (read-copy-update)
+    - unlinked nodes and old tables are retired and freed by the EpochDomain once no reader can hold them
+    - nodes come from a NodePool per shard : update / erase churn recycles blocks instead of calling malloc
+*/
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class RcuUnorderedMap {
+private:
+    struct Node {
+        size_t hash;   // full hash, kept so that growing never rehashes a key
+        Key key;
+        Value value;   // never written after the node is published
+        std::atomic<Node*> next;
+        Node(size_t h, const Key& k, const Value& v, Node* n) : hash(h), key(k), value(v), next(n) {}
+    };
+
+    struct Table {
+        size_t bucket_count;
+        std::unique_ptr<std::atomic<Node*>[]> heads;
+        explicit Table(size_t count) : bucket_count(count), heads(new std::atomic<Node*>[count]) {
+            for (size_t i = 0; i < count; ++i) {
+                heads[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+        std::atomic<Node*>& head_for(size_t hash) {
+            return heads[PowerOfTwoBucketPolicy::index_for(hash, bucket_count)];
+        }
+    };
+
+    struct Shard;
+
+    struct Retired {
+        void* object;
+        void (*destroy)(Shard&, void*);
+        uint64_t tag;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex write_mutex;            // writers of this shard only
+        std::atomic<Table*> table{nullptr};
+        std::atomic<size_t> size{0};
+        std::vector<Retired> retired;      // guarded by write_mutex
+        NodePool nodes{sizeof(Node)};      // guarded by write_mutex
+    };
+
+    static constexpr size_t kReclaimBatch = 64; // try to free retired objects every kReclaimBatch retirements
+
+    std::vector<Shard> shards_;
+    size_t shard_mask_;
+    float max_load_factor_;
+    Hash hasher_;
+    EpochDomain& epochs_;
+
+    static void destroy_node(Shard& shard, void* object) { shard.nodes.destroy(static_cast<Node*>(object)); }
+    static void destroy_table(Shard&, void* object) { delete static_cast<Table*>(object); }
+
+    // Writer side, called with the shard mutex held
+    void retire(Shard& shard, void* object, void (*destroy)(Shard&, void*)) {
+        shard.retired.push_back({object, destroy, epochs_.retire_tag()});
+        if (shard.retired.size() % kReclaimBatch == 0) {
+            reclaim(shard);
+        }
+    }
+
+    void reclaim(Shard& shard) {
+        uint64_t oldest = epochs_.oldest_active_epoch();
+        auto still_visible = std::partition(shard.retired.begin(), shard.retired.end(),
+                                            [oldest](const Retired& r) { return r.tag >= oldest; });
+        for (auto it = still_visible; it != shard.retired.end(); ++it) {
+            it->destroy(shard, it->object);
+        }
+        shard.retired.erase(still_visible, shard.retired.end());
+    }
+
+    // Copy every node into a table twice as large, publish it, then retire the old table and its nodes
+    void grow(Shard& shard, Table* old_table) {
+        Table* new_table = new Table(old_table->bucket_count * 2);
+        for (size_t i = 0; i < old_table->bucket_count; ++i) {
+            for (Node* n = old_table->heads[i].load(std::memory_order_relaxed); n; n = n->next.load(std::memory_order_relaxed)) {
+                std::atomic<Node*>& head = new_table->head_for(n->hash);
+                head.store(shard.nodes.template create<Node>(n->hash, n->key, n->value, head.load(std::memory_order_relaxed)),
+                           std::memory_order_relaxed);
+            }
+        }
+        shard.table.store(new_table, std::memory_order_release); // readers from now on only see the new table
+        for (size_t i = 0; i < old_table->bucket_count; ++i) {
+            for (Node* n = old_table->heads[i].load(std::memory_order_relaxed); n; n = n->next.load(std::memory_order_relaxed)) {
+                retire(shard, n, destroy_node);
+            }
+        }
+        retire(shard, old_table, destroy_table);
+    }
+
+    // Finds the link (bucket head or a node's next) pointing at key's node, or the null link at the end of the chain
+    std::atomic<Node*>* find_link(Table* table, size_t hash, const Key& key) {
+        std::atomic<Node*>* link = &table->head_for(hash);
+        for (Node* n = link->load(std::memory_order_relaxed); n; n = link->load(std::memory_order_relaxed)) {
+            if (n->hash == hash && n->key == key) {
+                break;
+            }
+            link = &n->next;
+        }
+        return link;
+    }
+
+    // Writer side of insert / insert_or_assign : returns true if the key was new
+    bool put(const Key& key, const Value& value, bool overwrite) {
+        size_t h = hasher_(key);
+        Shard& shard = shards_[shard_index(h, shard_mask_)];
+        std::lock_guard<std::mutex> lock(shard.write_mutex);
+        Table* table = shard.table.load(std::memory_order_relaxed);
+        std::atomic<Node*>* link = find_link(table, h, key);
+        Node* old_node = link->load(std::memory_order_relaxed);
+        if (old_node != nullptr) {
+            if (overwrite) {
+                link->store(shard.nodes.template create<Node>(h, key, value, old_node->next.load(std::memory_order_relaxed)),
+                            std::memory_order_release);
+                retire(shard, old_node, destroy_node);
+            }
+            return false;
+        }
+        std::atomic<Node*>& head = table->head_for(h);
+        head.store(shard.nodes.template create<Node>(h, key, value, head.load(std::memory_order_relaxed)),
+                   std::memory_order_release); // fully built before it is published
+        size_t size = shard.size.load(std::memory_order_relaxed) + 1;
+        shard.size.store(size, std::memory_order_relaxed);
+        if (size > table->bucket_count * max_load_factor_) {
+            grow(shard, table);
+        }
+        return true;
+    }
+
+    // Reader side : must be called inside a ReadGuard
+    const Node* find_node(size_t hash, const Key& key) const {
+        const Shard& shard = shards_[shard_index(hash, shard_mask_)];
+        Table* table = shard.table.load(std::memory_order_acquire);
+        for (Node* n = table->head_for(hash).load(std::memory_order_acquire); n; n = n->next.load(std::memory_order_acquire)) {
+            if (n->hash == hash && n->key == key) {
+                return n;
+            }
+        }
+        return nullptr;
+    }
+
+public:
+    // 1. Constructor with shard count (rounded up to a power of two) and initial buckets per shard
+    explicit RcuUnorderedMap(size_t shard_count = 64, size_t buckets_per_shard = 16)
+        : shards_(PowerOfTwoBucketPolicy::bucket_count_for(shard_count)), shard_mask_(shards_.size() - 1),
+          max_load_factor_(1.0), epochs_(EpochDomain::instance()) {
+        for (Shard& shard : shards_) {
+            shard.table.store(new Table(PowerOfTwoBucketPolicy::bucket_count_for(buckets_per_shard)), std::memory_order_relaxed);
+        }
+    }
+
+    RcuUnorderedMap(const RcuUnorderedMap&) = delete;
+    RcuUnorderedMap& operator=(const RcuUnorderedMap&) = delete;
+
+    // 2. Insert or update a key-value pair : an update swaps in a new node, readers see either the old or the new value
+    void insert_or_assign(const Key& key, const Value& value) {
+        put(key, value, true);
+    }
+
+    // 3. Insert a key-value pair, false if the key already exists
+    bool insert(const Key& key, const Value& value) {
+        return put(key, value, false);
+    }
+
+    // 4. Remove a key-value pair : the node is unlinked, readers already on it can still finish walking past it
+    bool erase(const Key& key) {
+        size_t h = hasher_(key);
+        Shard& shard = shards_[shard_index(h, shard_mask_)];
+        std::lock_guard<std::mutex> lock(shard.write_mutex);
+        std::atomic<Node*>* link = find_link(shard.table.load(std::memory_order_relaxed), h, key);
+        Node* node = link->load(std::memory_order_relaxed);
+        if (node == nullptr) {
+            return false;
+        }
+        link->store(node->next.load(std::memory_order_relaxed), std::memory_order_release);
+        shard.size.store(shard.size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        retire(shard, node, destroy_node);
+        return true;
+    }
+
+    // 5. Check if a key exists : wait-free, no lock
+    bool contains(const Key& key) const {
+        size_t h = hasher_(key);
+        EpochDomain::ReadGuard guard(epochs_);
+        return find_node(h, key) != nullptr;
+    }
+
+    // 6. Get a copy of the value of a key : wait-free, no lock
+    std::optional<Value> find(const Key& key) const {
+        size_t h = hasher_(key);
+        EpochDomain::ReadGuard guard(epochs_);
+        const Node* node = find_node(h, key);
+        return node ? std::optional<Value>(node->value) : std::nullopt; // copied before the guard ends
+    }
+
+    // 7. Get the number of elements (a snapshot under concurrent writes)
+    size_t size() const {
+        size_t total = 0;
+        for (const Shard& shard : shards_) {
+            total += shard.size.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    // Destructor : no reader may still be running, so everything is freed directly
+    ~RcuUnorderedMap() {
+        for (Shard& shard : shards_) {
+            Table* table = shard.table.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < table->bucket_count; ++i) {
+                Node* n = table->heads[i].load(std::memory_order_relaxed);
+                while (n != nullptr) {
+                    Node* next = n->next.load(std::memory_order_relaxed);
+                    shard.nodes.destroy(n);
+                    n = next;
+                }
+            }
+            delete table;
+            for (const Retired& r : shard.retired) {
+                r.destroy(shard, r.object);
+            }
+            // the shard's NodePool frees its chunks when shards_ is destroyed : no release(), which may throw, here
+        }
+    }
+};
+
+
+/*
+    CountMinSketch : approximate access frequency of keys in a few bytes per key, used as the TinyLFU admission filter
+    - 4 rows of 4-bit counters packed 16 per uint64_t, the estimate of a key is the smallest of its 4 counters
+    - counters saturate at 15 : TinyLFU only needs to tell popular keys from rare ones
+    - aging : after sample_size increments every counter is halved, so old popularity fades away
+*/
+class CountMinSketch {
+private:
+    std::vector<uint64_t> table_; // row r uses words [r * row_words_, (r + 1) * row_words_)
+    size_t row_words_;
+    size_t counter_mask_;         // counters per row - 1
+    size_t additions_;
+    size_t sample_size_;
+
+    size_t counter_index(uint64_t hash, int row) const {
+        uint64_t h = (hash + row * 0x9E3779B97F4A7C15ull) * 0xff51afd7ed558ccdull; // one multiply per row gives 4 independent indexes
+        return static_cast<size_t>((h ^ (h >> 32)) & counter_mask_);
+    }
+
+    void halve() {
+        for (uint64_t& word : table_) {
+            word = (word >> 1) & 0x7777777777777777ull; // halves the 16 counters of the word at once
+        }
+        additions_ /= 2;
+    }
+
+public:
+    // Sized for the number of entries the cache holds : ~one counter per entry and row
+    explicit CountMinSketch(size_t capacity)
+        : row_words_(PowerOfTwoBucketPolicy::bucket_count_for(std::max<size_t>(capacity, 16) / 16)),
+          counter_mask_(row_words_ * 16 - 1), additions_(0), sample_size_(10 * std::max<size_t>(capacity, 16)) {
+        table_.assign(4 * row_words_, 0);
+    }
+
+    void increment(uint64_t hash) {
+        for (int row = 0; row < 4; ++row) {
+            size_t counter = counter_index(hash, row);
+            uint64_t& word = table_[row * row_words_ + counter / 16];
+            int shift = static_cast<int>(counter % 16) * 4;
+            if (((word >> shift) & 0xF) != 0xF) {
+                word += 1ull << shift;
+            }
+        }
+        if (++additions_ >= sample_size_) {
+            halve();
+        }
+    }
+
+    int estimate(uint64_t hash) const {
+        int smallest = 15;
+        for (int row = 0; row < 4; ++row) {
+            size_t counter = counter_index(hash, row);
+            int shift = static_cast<int>(counter % 16) * 4;
+            smallest = std::min(smallest, static_cast<int>((table_[row * row_words_ + counter / 16] >> shift) & 0xF));
+        }
+        return smallest;
+    }
+};
+
+/*
+    TinyLfuCache : thread safe W-TinyLFU cache built on UnorderedMap
+    - keys are spread over lock-striped shards, each shard is an independent cache with its own mutex
+    - each shard keeps three UnorderedMaps whose insertion order is the LRU order (see LruCache) :
+        window     ~1% of the capacity, plain LRU, absorbs bursts of new keys
+        probation  main segment, entries seen once since admission
+        protected  ~80% of the main segment, entries hit again while on probation
+    - a key evicted from the window is only admitted into the main segment if the CountMinSketch says it is
+      accessed more often than the main segment's victim : one-off scan traffic never pushes out popular keys
+    - capacity is an entry count, split evenly across shards
+*/
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class TinyLfuCache {
+private:
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        UnorderedMap<Key, Value, Hash> window;
+        UnorderedMap<Key, Value, Hash> probation;
+        UnorderedMap<Key, Value, Hash> protected_;
+        CountMinSketch sketch;
+        size_t window_capacity;
+        size_t protected_capacity;
+        size_t main_capacity;
+        CacheStats stats;
+
+        explicit Shard(size_t capacity)
+            : sketch(capacity), window_capacity(std::max<size_t>(1, capacity / 100)),
+              protected_capacity((capacity - window_capacity) * 8 / 10), main_capacity(capacity - window_capacity) {}
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    size_t shard_mask_;
+    Hash hasher_;
+
+    // Probation hit : promote to protected, demoting protected's least recently used entry to probation if it is full
+    static Value* promote(Shard& shard, const Key& key) {
+        std::optional<Value> value;
+        {
+            Value* probation_value = shard.probation.find(key);
+            value.emplace(std::move(*probation_value));
+            shard.probation.erase(key);
+        }
+        shard.protected_.try_emplace(key, std::move(*value));
+        if (shard.protected_.size() > shard.protected_capacity) {
+            auto demoted = shard.protected_.pop_front();
+            shard.probation.try_emplace(std::move(demoted->key), std::move(demoted->value));
+        }
+        return shard.protected_.move_to_back(key); // still present : the demoted entry was the oldest, not this one
+    }
+
+    // Find key in any segment, refreshing its recency : nullptr on a miss
+    static Value* touch(Shard& shard, const Key& key) {
+        if (Value* value = shard.window.move_to_back(key)) {
+            return value;
+        }
+        if (Value* value = shard.protected_.move_to_back(key)) {
+            return value;
+        }
+        if (shard.probation.contains(key)) {
+            return promote(shard, key);
+        }
+        return nullptr;
+    }
+
+    // The window overflowed : its oldest entry competes with the main segment's victim for a place
+    void admit_from_window(Shard& shard) {
+        auto candidate = shard.window.pop_front();
+        if (shard.probation.size() + shard.protected_.size() < shard.main_capacity) {
+            shard.probation.try_emplace(std::move(candidate->key), std::move(candidate->value));
+            return;
+        }
+        auto& victims = shard.probation.empty() ? shard.protected_ : shard.probation;
+        const Key& victim = victims.begin()->key; // least recently used entry of the main segment
+        if (shard.sketch.estimate(hasher_(candidate->key)) > shard.sketch.estimate(hasher_(victim))) {
+            victims.pop_front();
+            ++shard.stats.evictions;
+            shard.probation.try_emplace(std::move(candidate->key), std::move(candidate->value));
+        } else {
+            ++shard.stats.rejections; // the candidate is dropped, the main segment is left untouched
+        }
+    }
+
+public:
+    // 1. Constructor with the total number of entries and the number of shards (rounded up to a power of two)
+    explicit TinyLfuCache(size_t capacity, size_t shard_count = 16) {
+        size_t shards = PowerOfTwoBucketPolicy::bucket_count_for(shard_count);
+        shard_mask_ = shards - 1;
+        for (size_t i = 0; i < shards; ++i) {
+            shards_.push_back(std::make_unique<Shard>(std::max<size_t>(2, capacity / shards)));
+        }
+    }
+
+    // 2. Get a copy of the value of key, recording the access in the frequency sketch : empty optional on a miss
+    std::optional<Value> get(const Key& key) {
+        size_t h = hasher_(key);
+        Shard& shard = *shards_[shard_index(h, shard_mask_)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.sketch.increment(h);
+        if (Value* value = touch(shard, key)) {
+            ++shard.stats.hits;
+            return *value;
+        }
+        ++shard.stats.misses;
+        return std::nullopt;
+    }
+
+    // 3. Insert or replace the value of key : new keys enter the window, which may push its oldest entry to admission
+    void put(const Key& key, const Value& value) {
+        size_t h = hasher_(key);
+        Shard& shard = *shards_[shard_index(h, shard_mask_)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.sketch.increment(h);
+        if (Value* existing = touch(shard, key)) {
+            *existing = value;
+            return;
+        }
+        shard.window.try_emplace(key, value);
+        ++shard.stats.insertions;
+        if (shard.window.size() > shard.window_capacity) {
+            admit_from_window(shard);
+        }
+    }
+
+    // 4. Remove key from whichever segment holds it
+    bool erase(const Key& key) {
+        Shard& shard = *shards_[shard_index(hasher_(key), shard_mask_)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.window.erase(key) || shard.probation.erase(key) || shard.protected_.erase(key);
+    }
+
+    // 5. Get the number of entries (a snapshot under concurrent writes)
+    size_t size() const {
+        size_t total = 0;
+        for (const auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            total += shard->window.size() + shard->probation.size() + shard->protected_.size();
+        }
+        return total;
+    }
+
+    // 6. Monitoring : counters summed over all shards
+    CacheStats stats() const {
+        CacheStats total;
+        for (const auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            total.hits += shard->stats.hits;
+            total.misses += shard->stats.misses;
+            total.insertions += shard->stats.insertions;
+            total.evictions += shard->stats.evictions;
+            total.rejections += shard->stats.rejections;
+        }
+        return total;
+    }
+};
+
+
+/*
+    Read-only snapshot format : a map written once to disk as an open-addressing table and mmapped by readers
+
+    file  = [ SnapshotHeader (64 bytes) ][ slot 0 ][ slot 1 ] ... [ slot slot_count - 1 ]
+    slot  = { uint64_t tag ; Key key ; Value value }    tag 0 = empty slot, else the key's stable hash with bit 0 set
+
+    - position independent : no pointers, only a header and a flat slot array, so the file can be mapped anywhere
+    - the slot of a key is (stable hash * 2^64/phi) >> (64 - log2(slot_count)), collisions probe linearly
+    - load factor 1/2, so a lookup touches one or two cache lines
+    - Key and Value must be trivially copyable, Key must also have no padding bits : hashing and comparing
+      its bytes is then the same as comparing keys (std::has_unique_object_representations)
+    - integers are stored in native byte order : a snapshot is read on the architecture that wrote it
+*/
+struct SnapshotHeader {
+    char magic[8];          // "UMSNAP1\0"
+    uint32_t version;
+    uint32_t slot_size;     // sizeof(SnapshotSlot<Key, Value>) of the writer
+    uint32_t key_size;
+    uint32_t value_size;
+    uint64_t slot_count;    // power of two
+    uint64_t size;          // number of keys
+    uint64_t slots_offset;  // byte offset of slot 0 from the start of the file
+    char reserved[16];
+};
+static_assert(sizeof(SnapshotHeader) == 64, "the snapshot header is exactly one cache line");
+
+template <typename Key, typename Value>
+struct SnapshotSlot {
+    uint64_t tag;
+    Key key;
+    Value value;
+};
+
+// Hash of the raw bytes of key : stable across processes and runs, unlike std::hash which may be seeded or differ per library
+template <typename Key>
+uint64_t stable_key_hash(const Key& key) {
+    unsigned char bytes[sizeof(Key)];
+    std::memcpy(bytes, &key, sizeof(Key));
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ sizeof(Key);
+    for (size_t i = 0; i < sizeof(Key); i += 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, bytes + i, std::min<size_t>(8, sizeof(Key) - i));
+        h = (h ^ word) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+    }
+    h ^= h >> 33; // murmur3 finalizer
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+template <typename Key, typename Value>
+void check_snapshot_types() {
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Value>,
+                  "snapshots store keys and values as raw bytes");
+    static_assert(std::has_unique_object_representations_v<Key>,
+                  "snapshot keys are hashed and compared by bytes, they must not contain padding or floating point");
+}
+
+// Write map to path in the snapshot format, throws std::runtime_error if the file cannot be written
+template <typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy, typename Stats>
+void write_snapshot(const UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy, Stats>& map, const std::string& path) {
+    check_snapshot_types<Key, Value>();
+    using Slot = SnapshotSlot<Key, Value>;
+    size_t slot_count = PowerOfTwoBucketPolicy::bucket_count_for(map.size() * 2);
+    std::vector<Slot> slots(slot_count); // value-initialized : every tag starts at 0 (empty)
+    for (const auto& pair : map) {
+        uint64_t h = stable_key_hash(pair.key);
+        size_t i = PowerOfTwoBucketPolicy::index_for(h, slot_count);
+        while (slots[i].tag != 0) {
+            i = (i + 1) & (slot_count - 1);
+        }
+        slots[i].tag = h | 1;
+        slots[i].key = pair.key;
+        slots[i].value = pair.value;
+    }
+    SnapshotHeader header{};
+    std::memcpy(header.magic, "UMSNAP1", 8);
+    header.version = 1;
+    header.slot_size = sizeof(Slot);
+    header.key_size = sizeof(Key);
+    header.value_size = sizeof(Value);
+    header.slot_count = slot_count;
+    header.size = map.size();
+    header.slots_offset = sizeof(SnapshotHeader); // 64 : slot 0 stays aligned for any Key / Value alignment up to 64
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(Slot));
+    if (!out) {
+        throw std::runtime_error("write_snapshot: cannot write " + path);
+    }
+}
+
+/*
+    MappedSnapshot : zero-copy read-only view of a snapshot file
+    - the constructor only maps the file and checks its header : opening costs the same for any table size
+    - pages are loaded lazily by the OS on first lookup and shared between processes mapping the same file
+*/
+template <typename Key, typename Value>
+class MappedSnapshot {
+private:
+    using Slot = SnapshotSlot<Key, Value>;
+
+    void* mapping_;
+    size_t mapping_size_;
+    const SnapshotHeader* header_;
+    const Slot* slots_;
+
+public:
+    // 1. Constructor : maps path read-only, throws std::runtime_error if it is not a snapshot of <Key, Value>
+    explicit MappedSnapshot(const std::string& path) : mapping_(nullptr), mapping_size_(0), header_(nullptr), slots_(nullptr) {
+        check_snapshot_types<Key, Value>();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("MappedSnapshot: cannot open " + path);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SnapshotHeader)) {
+            ::close(fd);
+            throw std::runtime_error("MappedSnapshot: " + path + " is too small to be a snapshot");
+        }
+        mapping_size_ = static_cast<size_t>(info.st_size);
+        mapping_ = ::mmap(nullptr, mapping_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // the mapping keeps the file alive
+        if (mapping_ == MAP_FAILED) {
+            throw std::runtime_error("MappedSnapshot: cannot map " + path);
+        }
+        header_ = static_cast<const SnapshotHeader*>(mapping_);
+        bool valid = std::memcmp(header_->magic, "UMSNAP1", 8) == 0 && header_->version == 1 &&
+                     header_->slot_size == sizeof(Slot) && header_->key_size == sizeof(Key) && header_->value_size == sizeof(Value) &&
+                     header_->slot_count != 0 && (header_->slot_count & (header_->slot_count - 1)) == 0 &&
+                     header_->slots_offset % alignof(Slot) == 0 &&
+                     header_->slots_offset <= mapping_size_ && // divide instead of multiply : a forged slot_count cannot overflow
+                     header_->slot_count <= (mapping_size_ - header_->slots_offset) / sizeof(Slot) &&
+                     header_->size <= header_->slot_count / 2; // write_snapshot keeps at least half the slots empty
+        if (!valid) {
+            ::munmap(mapping_, mapping_size_);
+            throw std::runtime_error("MappedSnapshot: " + path + " is not a snapshot of this key/value type");
+        }
+        slots_ = reinterpret_cast<const Slot*>(static_cast<const char*>(mapping_) + header_->slots_offset);
+    }
+
+    MappedSnapshot(const MappedSnapshot&) = delete;
+    MappedSnapshot& operator=(const MappedSnapshot&) = delete;
+
+    // 2. Move constructor : the mapping changes owner
+    MappedSnapshot(MappedSnapshot&& other) noexcept
+        : mapping_(other.mapping_), mapping_size_(other.mapping_size_), header_(other.header_), slots_(other.slots_) {
+        other.mapping_ = nullptr;
+    }
+
+    // 3. Find the value of a key : points into the mapped file, nullptr when the key is absent
+    const Value* find(const Key& key) const {
+        uint64_t h = stable_key_hash(key);
+        uint64_t tag = h | 1;
+        size_t mask = header_->slot_count - 1;
+        size_t i = PowerOfTwoBucketPolicy::index_for(h, header_->slot_count);
+        // at most slot_count probes : a corrupt file with no empty slot cannot make a miss loop forever
+        for (size_t probes = 0; probes < header_->slot_count; ++probes, i = (i + 1) & mask) {
+            const Slot& slot = slots_[i];
+            if (slot.tag == 0) {
+                return nullptr; // empty slot ends the probe sequence
+            }
+            if (slot.tag == tag && std::memcmp(&slot.key, &key, sizeof(Key)) == 0) {
+                return &slot.value;
+            }
+        }
+        return nullptr;
+    }
+
+    // 4. Check if a key exists
+    bool contains(const Key& key) const {
+        return find(key) != nullptr;
+    }
+
+    // 5. Get the number of keys
+    size_t size() const {
+        return header_->size;
+    }
+
+    // Destructor : unmaps the file
+    ~MappedSnapshot() {
+        if (mapping_ != nullptr) {
+            ::munmap(mapping_, mapping_size_);
+        }
+    }
+};
+
+/*
+    Binary stream format : compact checkpoint of a map, written and read sequentially (files, pipes, sockets)
+    stream = [ BinaryHeader (32 bytes) ][ record 0 ] ... [ record size - 1 ] , record = encoded key then encoded value
+    - BinaryCodec<T> encodes one type : trivially copyable types as their raw bytes (one memcpy),
+      std::string as a uint64_t length followed by its characters ; specialize it for other types
+    - records go through a 64 KB buffer and the stream sees one call per buffer, so a checkpoint is bound by I/O
+    - read_binary reserves the final size before the first insert : no rehash and no reallocation while loading
+    - counts and lengths read from the stream are checked against the bytes left before anything is allocated,
+      so a forged header fails with std::runtime_error ; when the stream cannot tell its length (pipe, socket)
+      reservations are capped and strings grow block by block, so a lie ends at "unexpected end of stream"
+    - integers are stored in native byte order, like snapshots
+*/
+struct BinaryHeader {
+    char magic[8];        // "UMBIN1\0\0"
+    uint32_t version;
+    uint32_t key_size;    // sizeof(Key) when it is stored as raw bytes, 0 for variable length encodings
+    uint32_t value_size;  // same for Value
+    uint32_t reserved;
+    uint64_t size;        // number of records
+};
+static_assert(sizeof(BinaryHeader) == 32, "fixed header layout");
+
+// Buffered sequential writer : bytes are staged and handed to the stream in kBufferSize blocks
+class BinaryWriter {
+private:
+    static constexpr size_t kBufferSize = 1 << 16;
+    std::ostream& out_;
+    std::vector<char> buffer_;
+
+public:
+    explicit BinaryWriter(std::ostream& out) : out_(out) {
+        buffer_.reserve(kBufferSize);
+    }
+
+    void write(const void* data, size_t bytes) {
+        if (buffer_.size() + bytes > kBufferSize) {
+            flush();
+        }
+        if (bytes >= kBufferSize) { // large blocks (long strings) skip the buffer
+            out_.write(static_cast<const char*>(data), bytes);
+            return;
+        }
+        const char* first = static_cast<const char*>(data);
+        buffer_.insert(buffer_.end(), first, first + bytes);
+    }
+
+    // Hand the staged bytes to the stream, throws std::runtime_error if the stream failed
+    void flush() {
+        out_.write(buffer_.data(), buffer_.size());
+        buffer_.clear();
+        if (!out_) {
+            throw std::runtime_error("BinaryWriter: write failed");
+        }
+    }
+};
+
+// Buffered sequential reader : refills kBufferSize bytes at a time, throws std::runtime_error on a truncated stream
+class BinaryReader {
+private:
+    static constexpr size_t kBufferSize = 1 << 16;
+    std::istream& in_;
+    std::vector<char> buffer_;
+    size_t position_;
+    size_t end_;
+    uint64_t unread_; // bytes not yet returned by read, UINT64_MAX when the stream cannot tell
+
+public:
+    static constexpr uint64_t kUnknown = UINT64_MAX;
+
+    explicit BinaryReader(std::istream& in) : in_(in), buffer_(kBufferSize), position_(0), end_(0), unread_(kUnknown) {
+        std::istream::pos_type start = in_.tellg();
+        if (start != std::istream::pos_type(-1) && in_.seekg(0, std::ios::end)) {
+            std::istream::pos_type stream_end = in_.tellg();
+            in_.seekg(start);
+            if (stream_end != std::istream::pos_type(-1) && stream_end >= start) {
+                unread_ = static_cast<uint64_t>(stream_end - start);
+            }
+        }
+        in_.clear(); // not seekable : leave unread_ unknown and read sequentially
+    }
+
+    // Bytes left in the stream, kUnknown for pipes and sockets
+    uint64_t remaining() const {
+        return unread_;
+    }
+
+    void read(void* data, size_t bytes) {
+        char* out = static_cast<char*>(data);
+        while (bytes > 0) {
+            if (position_ == end_) {
+                in_.read(buffer_.data(), buffer_.size());
+                position_ = 0;
+                end_ = static_cast<size_t>(in_.gcount());
+                if (end_ == 0) {
+                    throw std::runtime_error("BinaryReader: unexpected end of stream");
+                }
+            }
+            size_t chunk = std::min(bytes, end_ - position_);
+            std::memcpy(out, buffer_.data() + position_, chunk);
+            position_ += chunk;
+            out += chunk;
+            bytes -= chunk;
+            if (unread_ != kUnknown) {
+                unread_ -= chunk;
+            }
+        }
+    }
+};
+
+template <typename T, typename = void>
+struct BinaryCodec; // no definition : writing a type without a codec is a compile error
+
+template <typename T>
+struct BinaryCodec<T, std::enable_if_t<std::is_trivially_copyable_v<T>>> {
+    static constexpr uint32_t fixed_size = sizeof(T);
+    static void encode(BinaryWriter& out, const T& value) {
+        out.write(&value, sizeof(T));
+    }
+    static T decode(BinaryReader& in) {
+        T value;
+        in.read(&value, sizeof(T));
+        return value;
+    }
+};
+
+template <>
+struct BinaryCodec<std::string> {
+    static constexpr uint32_t fixed_size = 0;
+    static void encode(BinaryWriter& out, const std::string& value) {
+        uint64_t length = value.size();
+        out.write(&length, sizeof(length));
+        out.write(value.data(), value.size());
+    }
+    static std::string decode(BinaryReader& in) {
+        uint64_t length = BinaryCodec<uint64_t>::decode(in);
+        if (length > in.remaining()) {
+            throw std::runtime_error("BinaryReader: string length runs past the end of the stream");
+        }
+        // unknown stream length : grow 64 KB at a time, so a forged length fails on end of stream, not on allocation
+        uint64_t step = in.remaining() == BinaryReader::kUnknown ? uint64_t(1) << 16 : length;
+        std::string value;
+        while (value.size() < length) {
+            size_t done = value.size();
+            size_t chunk = static_cast<size_t>(std::min<uint64_t>(length - done, step));
+            value.resize(done + chunk);
+            in.read(value.data() + done, chunk);
+        }
+        return value;
+    }
+};
+
+// Write map to out in the binary stream format, throws std::runtime_error if the stream fails
+template <typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy, typename Stats>
+void write_binary(const UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy, Stats>& map, std::ostream& out) {
+    BinaryHeader header{};
+    std::memcpy(header.magic, "UMBIN1", 7);
+    header.version = 1;
+    header.key_size = BinaryCodec<Key>::fixed_size;
+    header.value_size = BinaryCodec<Value>::fixed_size;
+    header.size = map.size();
+    BinaryWriter writer(out);
+    writer.write(&header, sizeof(header));
+    for (const auto& pair : map) {
+        BinaryCodec<Key>::encode(writer, pair.key);
+        BinaryCodec<Value>::encode(writer, pair.value);
+    }
+    writer.flush();
+}
+
+// Replace the content of map with the records of in, throws std::runtime_error on a foreign or truncated stream
+template <typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy, typename Stats>
+void read_binary(std::istream& in, UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy, Stats>& map) {
+    BinaryReader reader(in);
+    BinaryHeader header;
+    reader.read(&header, sizeof(header));
+    if (std::memcmp(header.magic, "UMBIN1", 7) != 0 || header.version != 1) {
+        throw std::runtime_error("read_binary: not an UnorderedMap binary stream");
+    }
+    if (header.key_size != BinaryCodec<Key>::fixed_size || header.value_size != BinaryCodec<Value>::fixed_size) {
+        throw std::runtime_error("read_binary: stream was written for other key or value types");
+    }
+    // every record takes at least this many bytes : fixed size types their size, strings their length prefix
+    constexpr uint64_t kMinRecordBytes = (BinaryCodec<Key>::fixed_size ? BinaryCodec<Key>::fixed_size : sizeof(uint64_t)) +
+                                         (BinaryCodec<Value>::fixed_size ? BinaryCodec<Value>::fixed_size : sizeof(uint64_t));
+    constexpr uint64_t kMaxBlindReserve = uint64_t(1) << 20; // entries reserved up front when the stream length is unknown
+    if (header.size > reader.remaining() / kMinRecordBytes) {
+        throw std::runtime_error("read_binary: record count runs past the end of the stream");
+    }
+    map.clear();
+    map.reserve(static_cast<size_t>(reader.remaining() == BinaryReader::kUnknown ? std::min(header.size, kMaxBlindReserve) : header.size));
+    for (uint64_t i = 0; i < header.size; ++i) {
+        Key key = BinaryCodec<Key>::decode(reader);
+        map.insert_or_assign(std::move(key), BinaryCodec<Value>::decode(reader));
+    }
+}
+
+
+
+/*
+    StaticPerfectMap : string-keyed map whose keys are fixed at compile time (command tables, keyword lists)
+    Built by a constexpr hash-and-displace (CHD style) search :
+    - every key is hashed once (FNV-1a) and put in one of ~N/4 groups by the low bits of its hash
+    - groups are placed largest first : for each group, seeds 0, 1, 2, ... are tried until
+      slot(hash ^ seed) is free and distinct for every key of the group, and that seed is stored for the group
+    - the result is collision free : a lookup is hash, one seed load, xor + multiply + shift, one key compare
+    - a duplicate key or a failed search is a compile error (throw is not allowed in a constant expression)
+*/
+constexpr uint64_t fnv1a_hash(std::string_view key) {
+    uint64_t h = 14695981039346656037ull;
+    for (char c : key) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+constexpr size_t next_power_of_two(size_t n) {
+    size_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+template <typename Value, size_t N>
+class StaticPerfectMap {
+private:
+    static constexpr size_t kSlots = next_power_of_two(N + N / 4 + 2); // load factor at most 0.8 keeps the search short
+    static constexpr size_t kGroups = next_power_of_two((N + 3) / 4);
+    static constexpr int kSlotBits = __builtin_ctzll(kSlots);
+    static constexpr uint32_t kMaxSeed = 1u << 16;
+
+    std::array<std::string_view, kSlots> keys_{};
+    std::array<Value, kSlots> values_{};
+    std::array<bool, kSlots> occupied_{};
+    std::array<uint32_t, kGroups> seeds_{};
+
+    static constexpr size_t group_of(uint64_t h) {
+        return static_cast<size_t>(h & (kGroups - 1));
+    }
+    static constexpr size_t slot_of(uint64_t h, uint32_t seed) {
+        return static_cast<size_t>(((h ^ seed) * 11400714819323198485ull) >> (64 - kSlotBits));
+    }
+
+public:
+    // 1. Constructor : runs the displacement search, meant to be evaluated at compile time (constexpr variable)
+    constexpr explicit StaticPerfectMap(const std::pair<std::string_view, Value> (&entries)[N]) {
+        std::array<uint64_t, N> hashes{};
+        std::array<size_t, kGroups + 1> group_start{}; // counting sort of the keys by group
+        for (size_t i = 0; i < N; ++i) {
+            hashes[i] = fnv1a_hash(entries[i].first);
+            ++group_start[group_of(hashes[i]) + 1];
+            for (size_t j = 0; j < i; ++j) {
+                if (entries[j].first == entries[i].first) {
+                    throw std::logic_error("StaticPerfectMap: duplicate key");
+                }
+            }
+        }
+        for (size_t g = 0; g < kGroups; ++g) {
+            group_start[g + 1] += group_start[g];
+        }
+        std::array<size_t, N> members{};
+        std::array<size_t, kGroups> filled{};
+        for (size_t i = 0; i < N; ++i) {
+            size_t g = group_of(hashes[i]);
+            members[group_start[g] + filled[g]++] = i;
+        }
+        std::array<size_t, kGroups> order{}; // groups sorted by decreasing size : the hardest groups are placed first
+        for (size_t g = 0; g < kGroups; ++g) {
+            size_t at = g;
+            while (at > 0 && filled[order[at - 1]] < filled[g]) {
+                order[at] = order[at - 1];
+                --at;
+            }
+            order[at] = g;
+        }
+        for (size_t g : order) {
+            size_t first = group_start[g], last = group_start[g + 1];
+            if (first == last) {
+                break;
+            }
+            uint32_t seed = 0;
+            for (;; ++seed) {
+                if (seed == kMaxSeed) {
+                    throw std::logic_error("StaticPerfectMap: no perfect hash found");
+                }
+                bool fits = true;
+                for (size_t a = first; a < last && fits; ++a) {
+                    size_t slot = slot_of(hashes[members[a]], seed);
+                    fits = !occupied_[slot];
+                    for (size_t b = first; b < a && fits; ++b) {
+                        fits = slot_of(hashes[members[b]], seed) != slot;
+                    }
+                }
+                if (fits) {
+                    break;
+                }
+            }
+            seeds_[g] = seed;
+            for (size_t a = first; a < last; ++a) {
+                size_t slot = slot_of(hashes[members[a]], seed);
+                occupied_[slot] = true;
+                keys_[slot] = entries[members[a]].first;
+                values_[slot] = entries[members[a]].second;
+            }
+        }
+    }
+
+    // 2. Find the value of a key : nullptr when the key is not one of the compile time keys
+    constexpr const Value* find(std::string_view key) const {
+        uint64_t h = fnv1a_hash(key);
+        size_t slot = slot_of(h, seeds_[group_of(h)]);
+        return occupied_[slot] && keys_[slot] == key ? &values_[slot] : nullptr;
+    }
+
+    // 3. Check if a key exists
+    constexpr bool contains(std::string_view key) const {
+        return find(key) != nullptr;
+    }
+
+    // 4. Get the number of keys
+    static constexpr size_t size() {
+        return N;
+    }
+};
+
+// Deduces Value and N : constexpr auto table = make_static_map<int>({{"GET", 1}, {"SET", 2}});
+template <typename Value, size_t N>
+constexpr StaticPerfectMap<Value, N> make_static_map(const std::pair<std::string_view, Value> (&entries)[N]) {
+    return StaticPerfectMap<Value, N>(entries);
+}
+
+
+// Wall-clock milliseconds taken by body(), shared by the benchmarks below
+template <typename Body>
+double time_ms(Body&& body) {
+    auto start = chrono::steady_clock::now();
+    body();
+    return chrono::duration<double, std::milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Benchmark : inserts then looks up every key with the given bucket policy and reports the longest chain
+template <typename Policy>
+void benchmark_bucket_policy(const char* name, const char* pattern, const std::vector<long long>& keys) {
+    UnorderedMap<long long, long long, std::hash<long long>, std::equal_to<long long>, Policy> map; // std::hash<long long> is the identity on libstdc++
+    double insert_ms = time_ms([&] {
+        for (long long key : keys) {
+            map.insert(key, key);
+        }
+    });
+    long long checksum = 0;
+    double lookup_ms = time_ms([&] {
+        for (int round = 0; round < 4; ++round) {
+            for (long long key : keys) {
+                checksum += map.contains(key);
+            }
+        }
+    });
+    size_t longest_chain = 0;
+    for (size_t i = 0; i < map.bucket_count(); ++i) {
+        longest_chain = std::max(longest_chain, map.bucket_size(i));
+    }
+    cout << pattern << " " << name
+         << " insert " << insert_ms << " ms"
+         << ", lookup " << lookup_ms << " ms"
+         << ", longest chain " << longest_chain << " (checksum " << checksum << ")" << endl;
+}
+
+void benchmark_bucket_policies() {
+    std::vector<long long> sequential, strided;
+    for (long long i = 0; i < (1 << 20); ++i) {
+        sequential.push_back(i);
+    }
+    for (long long i = 0; i < (1 << 15); ++i) {
+        strided.push_back(i * 1024); // keys sharing their low bits : modulo a bucket count with a large power of two factor piles them up
+    }
+    benchmark_bucket_policy<ModuloBucketPolicy>("modulo", "sequential", sequential);
+    benchmark_bucket_policy<PowerOfTwoBucketPolicy>("power-of-two", "sequential", sequential);
+    benchmark_bucket_policy<FastRangeBucketPolicy>("fastrange", "sequential", sequential);
+    benchmark_bucket_policy<ModuloBucketPolicy>("modulo", "strided", strided);
+    benchmark_bucket_policy<PowerOfTwoBucketPolicy>("power-of-two", "strided", strided);
+    benchmark_bucket_policy<FastRangeBucketPolicy>("fastrange", "strided", strided);
+}
+
+// Baseline for the concurrency benchmarks : one UnorderedMap behind one global mutex
+template <typename Key, typename Value>
+class GlobalLockMap {
+private:
+    mutable std::mutex mutex_;
+    UnorderedMap<Key, Value> map_;
+
+public:
+    bool contains(const Key& key) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return map_.contains(key);
+    }
+    void insert_or_assign(const Key& key, const Value& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        map_.insert_or_assign(key, value);
+    }
+};
+
+// Runs total_ops random operations split across `threads` threads, read_percent of them lookups, and returns Mops/s
+template <typename Map>
+double run_concurrent_mix(Map& map, int threads, int read_percent, size_t total_ops, uint64_t key_range) {
+    std::vector<std::thread> workers;
+    double ms = time_ms([&] {
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&map, t, threads, read_percent, total_ops, key_range] {
+                uint64_t state = 0x9E3779B97F4A7C15ull * (t + 1); // per thread xorshift generator, no shared state
+                size_t found = 0;
+                for (size_t i = 0; i < total_ops / threads; ++i) {
+                    state ^= state << 13;
+                    state ^= state >> 7;
+                    state ^= state << 17;
+                    uint64_t key = state % key_range;
+                    if (static_cast<int>(state >> 57) % 100 < read_percent) {
+                        found += map.contains(key);
+                    } else {
+                        map.insert_or_assign(key, state);
+                    }
+                }
+                if (found == static_cast<size_t>(-1)) {
+                    cout << found; // keeps the lookups from being optimised away
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    });
+    return total_ops / (ms / 1000) / 1e6;
+}
+
+void benchmark_concurrent_map() {
+    const uint64_t key_range = 100000;
+    const size_t total_ops = 1 << 20;
+    for (int read_percent : {95, 50}) {
+        cout << (read_percent == 95 ? "read-heavy (95% reads)" : "write-heavy (50% reads)") << endl;
+        for (int threads : {1, 2, 4, 8, 16, 32, 64}) {
+            GlobalLockMap<uint64_t, uint64_t> locked;
+            ConcurrentUnorderedMap<uint64_t, uint64_t> sharded;
+            for (uint64_t key = 0; key < key_range; key += 2) { // half of the lookups hit
+                locked.insert_or_assign(key, key);
+                sharded.insert_or_assign(key, key);
+            }
+            double locked_mops = run_concurrent_mix(locked, threads, read_percent, total_ops, key_range);
+            double sharded_mops = run_concurrent_mix(sharded, threads, read_percent, total_ops, key_range);
+            cout << "  " << threads << " threads : global mutex " << locked_mops << " Mops/s, sharded " << sharded_mops << " Mops/s" << endl;
+        }
+    }
+}
+
+void benchmark_rcu_map() {
+    const uint64_t key_range = 100000;
+    const size_t total_ops = 1 << 20;
+    cout << "read-mostly (99% reads)" << endl;
+    for (int threads : {1, 2, 4, 8, 16, 32, 64}) {
+        GlobalLockMap<uint64_t, uint64_t> locked;
+        ConcurrentUnorderedMap<uint64_t, uint64_t> sharded;
+        RcuUnorderedMap<uint64_t, uint64_t> rcu;
+        for (uint64_t key = 0; key < key_range; key += 2) {
+            locked.insert_or_assign(key, key);
+            sharded.insert_or_assign(key, key);
+            rcu.insert_or_assign(key, key);
+        }
+        double locked_mops = run_concurrent_mix(locked, threads, 99, total_ops, key_range);
+        double sharded_mops = run_concurrent_mix(sharded, threads, 99, total_ops, key_range);
+        double rcu_mops = run_concurrent_mix(rcu, threads, 99, total_ops, key_range);
+        cout << "  " << threads << " threads : global mutex " << locked_mops << " Mops/s, sharded rwlock " << sharded_mops
+             << " Mops/s, rcu " << rcu_mops << " Mops/s" << endl;
+    }
+}
+
+// Benchmark : one-by-one lookups against find_batch / contains_batch on a table of `count` random keys
+void benchmark_batch_lookup(size_t count) {
+    std::vector<std::pair<uint64_t, uint64_t>> items;
+    uint64_t state = 88172645463325252ull;
+    for (size_t i = 0; i < count; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        items.emplace_back(state, i);
+    }
+    UnorderedMap<uint64_t, uint64_t> map;
+    double one_by_one_insert = time_ms([&] {
+        for (const auto& item : items) {
+            map.insert(item.first, item.second);
+        }
+    });
+    UnorderedMap<uint64_t, uint64_t> batched;
+    double batch_insert = time_ms([&] { batched.insert_batch(items); });
+
+    std::vector<uint64_t> keys;
+    for (size_t i = 0; i < (1 << 20); ++i) {
+        keys.push_back(items[(i * 2654435761u) % count].first); // random order over the whole table
+    }
+    size_t hits = 0;
+    double one_by_one = time_ms([&] {
+        for (uint64_t key : keys) {
+            hits += map.find(key) != nullptr;
+        }
+    });
+    std::vector<const uint64_t*> values;
+    std::vector<bool> found;
+    double batch_find = time_ms([&] {
+        for (size_t begin = 0; begin < keys.size(); begin += 4096) { // batches of 4096 keys, as a request handler would
+            std::vector<uint64_t> batch(keys.begin() + begin, keys.begin() + std::min(keys.size(), begin + 4096));
+            hits += map.find_batch(batch, values);
+        }
+    });
+    double batch_contains = time_ms([&] {
+        for (size_t begin = 0; begin < keys.size(); begin += 4096) {
+            std::vector<uint64_t> batch(keys.begin() + begin, keys.begin() + std::min(keys.size(), begin + 4096));
+            hits += map.contains_batch(batch, found);
+        }
+    });
+    cout << count << " keys : insert " << one_by_one_insert << " ms, insert_batch " << batch_insert << " ms"
+         << " | 1M lookups : find " << one_by_one << " ms, find_batch " << batch_find << " ms, contains_batch " << batch_contains
+         << " ms (hits " << hits << ")" << endl;
+}
+
+// Zipfian key generator over [0, n) : P(k) ~ 1 / (k + 1)^skew, sampled by binary search on the precomputed CDF
+class ZipfianGenerator {
+private:
+    std::vector<double> cdf_;
+    uint64_t state_;
+
+public:
+    ZipfianGenerator(size_t n, double skew, uint64_t seed) : state_(seed) {
+        double sum = 0;
+        for (size_t k = 0; k < n; ++k) {
+            sum += 1.0 / std::pow(static_cast<double>(k + 1), skew);
+            cdf_.push_back(sum);
+        }
+        for (double& c : cdf_) {
+            c /= sum;
+        }
+    }
+
+    uint64_t next() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        double u = (state_ >> 11) * (1.0 / 9007199254740992.0); // uniform in [0, 1)
+        return std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin();
+    }
+};
+
+// Traces for the cache benchmarks : Zipfian requests, optionally interleaved with scans of keys never seen again
+std::vector<uint64_t> make_cache_trace(size_t requests, bool with_scans) {
+    ZipfianGenerator zipf(100000, 0.9, 42);
+    std::vector<uint64_t> trace;
+    uint64_t next_scan_key = 1ull << 40; // scan keys never collide with Zipfian keys
+    while (trace.size() < requests) {
+        for (int i = 0; i < 10000 && trace.size() < requests; ++i) {
+            trace.push_back(zipf.next());
+        }
+        if (with_scans) {
+            for (int i = 0; i < 5000 && trace.size() < requests; ++i) { // a 5000 key scan after every 10000 requests
+                trace.push_back(next_scan_key++);
+            }
+        }
+    }
+    return trace;
+}
+
+// Read-through simulation : get, and put on a miss
+template <typename Cache>
+double replay_trace(Cache& cache, const std::vector<uint64_t>& trace, size_t begin, size_t end) {
+    size_t hits = 0;
+    for (size_t i = begin; i < end; ++i) {
+        if (cache.get(trace[i])) {
+            ++hits;
+        } else {
+            cache.put(trace[i], trace[i]);
+        }
+    }
+    return static_cast<double>(hits) / (end - begin);
+}
+
+void benchmark_caches() {
+    const size_t capacity = 2000;
+    for (bool with_scans : {false, true}) {
+        std::vector<uint64_t> trace = make_cache_trace(1000000, with_scans);
+        LruCache<uint64_t, uint64_t> lru(capacity * ShallowEntrySize{}(uint64_t(), uint64_t()));
+        TinyLfuCache<uint64_t, uint64_t> tiny_lfu(capacity);
+        cout << (with_scans ? "zipf 0.9 + scans" : "zipf 0.9") << " hit ratio, " << capacity << " entries : lru "
+             << replay_trace(lru, trace, 0, trace.size()) << ", w-tinylfu " << replay_trace(tiny_lfu, trace, 0, trace.size()) << endl;
+    }
+    std::vector<uint64_t> trace = make_cache_trace(1 << 20, false);
+    for (int threads : {1, 2, 4, 8, 16}) {
+        TinyLfuCache<uint64_t, uint64_t> cache(capacity * 16, 64);
+        std::vector<std::thread> workers;
+        double ms = time_ms([&] {
+            for (int t = 0; t < threads; ++t) {
+                workers.emplace_back([&cache, &trace, t, threads] {
+                    replay_trace(cache, trace, trace.size() / threads * t, trace.size() / threads * (t + 1));
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        });
+        cout << "  w-tinylfu " << threads << " threads : " << trace.size() / (ms / 1000) / 1e6 << " Mops/s" << endl;
+    }
+}
+
+// Benchmark : startup cost of rebuilding a table pair by pair against opening its snapshot
+void benchmark_snapshot(size_t count) {
+    std::vector<std::pair<uint64_t, uint64_t>> pairs;
+    for (uint64_t i = 0; i < count; ++i) {
+        pairs.emplace_back(i * 0x9E3779B97F4A7C15ull, i);
+    }
+    UnorderedMap<uint64_t, uint64_t> source;
+    source.insert_batch(pairs);
+    const std::string path = "unordered_map_snapshot.bin";
+    write_snapshot(source, path);
+
+    UnorderedMap<uint64_t, uint64_t> rebuilt;
+    double rebuild_ms = time_ms([&] {
+        for (const auto& pair : pairs) {
+            rebuilt.insert(pair.first, pair.second);
+        }
+    });
+    std::optional<MappedSnapshot<uint64_t, uint64_t>> snapshot;
+    double open_ms = time_ms([&] { snapshot.emplace(path); });
+    uint64_t checksum = 0;
+    double lookup_ms = time_ms([&] {
+        for (size_t i = 0; i < (1 << 20); ++i) {
+            checksum += *snapshot->find(pairs[(i * 2654435761u) % count].first);
+        }
+    });
+    cout << count << " keys : rebuild " << rebuild_ms << " ms, open snapshot " << open_ms << " ms, 1M snapshot lookups "
+         << lookup_ms << " ms (checksum " << checksum << ")" << endl;
+    std::remove(path.c_str());
+}
+
+// Benchmark : group-by counting and grouping of 4M events over distinct_keys Zipfian keys
+void benchmark_group_by(size_t distinct_keys) {
+    const size_t events = 1 << 22;
+    ZipfianGenerator zipf(distinct_keys, 0.9, 7);
+    std::vector<uint64_t> keys(events);
+    for (uint64_t& key : keys) {
+        key = zipf.next() * 0x9E3779B97F4A7C15ull;
+    }
+    uint64_t checksum = 0;
+
+    double subscript_ms = time_ms([&] {
+        UnorderedMap<uint64_t, uint64_t> counts;
+        for (uint64_t key : keys) {
+            ++counts[key];
+        }
+        checksum += counts.size();
+    });
+    double add_ms = time_ms([&] {
+        CountingMap<uint64_t> counts;
+        for (uint64_t key : keys) {
+            counts.add(key);
+        }
+        checksum += counts.size();
+    });
+    double add_all_ms = time_ms([&] {
+        CountingMap<uint64_t> counts;
+        counts.add_all(keys);
+        checksum += counts.size();
+    });
+    cout << distinct_keys << " keys, count 4M events : operator[]++ " << subscript_ms << " ms, CountingMap::add " << add_ms << " ms, CountingMap::add_all "
+         << add_all_ms << " ms" << endl;
+
+    double vectors_ms = time_ms([&] {
+        UnorderedMap<uint64_t, std::vector<uint32_t>> groups;
+        for (size_t i = 0; i < events; ++i) {
+            groups[keys[i]].push_back(static_cast<uint32_t>(i));
+        }
+        groups.for_each([&checksum](const uint64_t&, const std::vector<uint32_t>& values) {
+            for (uint32_t value : values) {
+                checksum += value;
+            }
+        });
+    });
+    double multimap_ms = time_ms([&] {
+        UnorderedMultiMap<uint64_t, uint32_t> groups;
+        for (size_t i = 0; i < events; ++i) {
+            groups.insert(keys[i], static_cast<uint32_t>(i));
+        }
+        groups.for_each_group([&checksum](const uint64_t&, const uint32_t* values, size_t count) {
+            for (size_t j = 0; j < count; ++j) {
+                checksum += values[j];
+            }
+        });
+    });
+    cout << "group 4M events + scan : UnorderedMap<K, vector<V>> " << vectors_ms << " ms, UnorderedMultiMap " << multimap_ms
+         << " ms (checksum " << checksum << ")" << endl;
+}
+
+// Benchmark : serial build / merge into one UnorderedMap against the two-phase parallel PartitionedMap versions
+void benchmark_parallel_build() {
+    const size_t count = 1 << 22;
+    std::vector<std::pair<uint64_t, uint64_t>> items;
+    items.reserve(count);
+    uint64_t state = 88172645463325252ull;
+    for (size_t i = 0; i < count; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        items.emplace_back(state % (count / 2), 1); // every key appears about twice
+    }
+    auto sum = [](uint64_t& total, uint64_t value) { total += value; };
+
+    const size_t parts = 8;
+    std::vector<UnorderedMap<uint64_t, uint64_t>> partial(parts);
+    for (size_t i = 0; i < count; ++i) {
+        partial[i % parts].upsert(items[i].first, [&](uint64_t& total) { total += items[i].second; });
+    }
+    std::vector<const UnorderedMap<uint64_t, uint64_t>*> sources;
+    for (const auto& map : partial) {
+        sources.push_back(&map);
+    }
+
+    size_t serial_size = 0;
+    double build_ms = time_ms([&] {
+        UnorderedMap<uint64_t, uint64_t> map;
+        for (const auto& item : items) {
+            map.upsert(item.first, [&](uint64_t& total) { total += item.second; });
+        }
+        serial_size = map.size();
+    });
+    double merge_ms = time_ms([&] {
+        UnorderedMap<uint64_t, uint64_t> map;
+        for (const auto* source : sources) {
+            for (const auto& pair : *source) {
+                map.upsert(pair.key, [&](uint64_t& total) { total += pair.value; });
+            }
+        }
+    });
+    cout << "4M pairs, " << serial_size << " keys : serial build " << build_ms << " ms, serial merge of " << parts << " maps " << merge_ms
+         << " ms" << endl;
+    for (size_t threads : {1, 2, 4, 8}) {
+        double parallel_build_ms = time_ms([&] {
+            PartitionedMap<uint64_t, uint64_t> map;
+            map.build(items, threads, sum);
+        });
+        double parallel_merge_ms = time_ms([&] {
+            PartitionedMap<uint64_t, uint64_t> map;
+            map.merge(sources, threads, sum);
+        });
+        cout << "  " << threads << " threads : parallel build " << parallel_build_ms << " ms, parallel merge " << parallel_merge_ms << " ms"
+             << endl;
+    }
+}
+
+// Benchmark : copy constructor and binary checkpoint write / read of a map of count integer pairs
+void benchmark_binary_format(size_t count) {
+    UnorderedMap<uint64_t, uint64_t> map;
+    for (uint64_t i = 0; i < count; ++i) {
+        map.insert(i * 0x9E3779B97F4A7C15ull, i);
+    }
+    size_t copied = 0;
+    double copy_ms = time_ms([&] {
+        UnorderedMap<uint64_t, uint64_t> copy(map);
+        copied = copy.size();
+    });
+    const std::string path = "unordered_map_checkpoint.bin";
+    double write_ms = time_ms([&] {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        write_binary(map, out);
+    });
+    UnorderedMap<uint64_t, uint64_t> loaded;
+    double read_ms = time_ms([&] {
+        std::ifstream in(path, std::ios::binary);
+        read_binary(in, loaded);
+    });
+    std::remove(path.c_str());
+    double megabytes = (sizeof(BinaryHeader) + count * 2 * sizeof(uint64_t)) / 1e6;
+    cout << count << " pairs : copy " << copy_ms << " ms, write_binary " << write_ms << " ms (" << megabytes / write_ms * 1000 << " MB/s), read_binary "
+         << read_ms << " ms (" << megabytes / read_ms * 1000 << " MB/s), " << copied << " / " << loaded.size() << " pairs" << endl;
+}
+
+// Keys that all land in bucket 0 of an UnorderedMap with std::hash<uint64_t> (identity) and the power-of-two policy :
+// key * golden ratio multiplier = j, whose top bits are 0 for every table size
+std::vector<uint64_t> make_colliding_keys(size_t count) {
+    const uint64_t multiplier = 11400714819323198485ull;
+    uint64_t inverse = multiplier; // Newton iteration for the inverse modulo 2^64, each step doubles the correct low bits
+    for (int i = 0; i < 5; ++i) {
+        inverse *= 2 - multiplier * inverse;
+    }
+    std::vector<uint64_t> keys;
+    for (uint64_t j = 1; j <= count; ++j) {
+        keys.push_back(j * inverse);
+    }
+    return keys;
+}
+
+// Benchmark : SeededHash overhead on random keys, and insert cost under a hash flooding attack
+void benchmark_seeded_hash() {
+    auto insert_and_find = [](auto& map, const auto& keys) {
+        for (const auto& key : keys) {
+            map.insert(key, 1);
+        }
+        size_t hits = 0;
+        for (const auto& key : keys) {
+            hits += map.contains(key);
+        }
+        return hits;
+    };
+    const size_t count = 1 << 20;
+    std::vector<uint64_t> numbers;
+    std::vector<string> words;
+    uint64_t state = 0x2545F4914F6CDD1Dull;
+    for (size_t i = 0; i < count; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        numbers.push_back(state);
+        words.push_back("user:" + std::to_string(state % 100000000));
+    }
+    size_t hits = 0;
+    double std_numbers_ms = time_ms([&] {
+        UnorderedMap<uint64_t, int> map;
+        hits += insert_and_find(map, numbers);
+    });
+    double seeded_numbers_ms = time_ms([&] {
+        UnorderedMap<uint64_t, int, SeededHash> map;
+        hits += insert_and_find(map, numbers);
+    });
+    double std_words_ms = time_ms([&] {
+        UnorderedMap<string, int, StringHash> map;
+        hits += insert_and_find(map, words);
+    });
+    double seeded_words_ms = time_ms([&] {
+        UnorderedMap<string, int, SeededHash> map;
+        hits += insert_and_find(map, words);
+    });
+    cout << "1M inserts + 1M lookups : uint64 std::hash " << std_numbers_ms << " ms, SeededHash " << seeded_numbers_ms << " ms ; string std::hash "
+         << std_words_ms << " ms, SeededHash " << seeded_words_ms << " ms (" << hits << " hits)" << endl;
+
+    std::vector<uint64_t> attack = make_colliding_keys(1 << 14);
+    size_t std_chain = 0, seeded_chain = 0, reseeds = 0;
+    double std_attack_ms = time_ms([&] {
+        UnorderedMap<uint64_t, int> map;
+        hits += insert_and_find(map, attack);
+        std_chain = map.max_chain_length();
+    });
+    double seeded_attack_ms = time_ms([&] {
+        UnorderedMap<uint64_t, int, SeededHash, std::equal_to<uint64_t>, PowerOfTwoBucketPolicy, MapStats> map;
+        hits += insert_and_find(map, attack);
+        seeded_chain = map.max_chain_length();
+        reseeds = map.stats().reseed_count;
+    });
+    cout << "16K colliding keys : std::hash " << std_attack_ms << " ms (longest chain " << std_chain << "), SeededHash " << seeded_attack_ms
+         << " ms (longest chain " << seeded_chain << ", " << reseeds << " reseeds)" << endl;
+}
+
+// Plain node used by the NodePool demo
+struct KeyValuePairDemo {
+    int key;
+    int value;
+};
+
+// Command table shared by the demo and the benchmark : resolved entirely at compile time
+constexpr auto kCommandTable = make_static_map<int>({
+    {"GET", 1}, {"SET", 2}, {"DEL", 3}, {"EXISTS", 4}, {"EXPIRE", 5}, {"TTL", 6}, {"INCR", 7}, {"DECR", 8},
+    {"MGET", 9}, {"MSET", 10}, {"HGET", 11}, {"HSET", 12}, {"HDEL", 13}, {"LPUSH", 14}, {"RPUSH", 15}, {"LPOP", 16},
+    {"RPOP", 17}, {"LRANGE", 18}, {"SADD", 19}, {"SREM", 20}, {"SMEMBERS", 21}, {"ZADD", 22}, {"ZRANGE", 23}, {"PING", 24},
+    {"ECHO", 25}, {"AUTH", 26}, {"SELECT", 27}, {"FLUSHDB", 28}, {"KEYS", 29}, {"SCAN", 30}, {"INFO", 31}, {"QUIT", 32},
+});
+static_assert(*kCommandTable.find("SCAN") == 30 && !kCommandTable.contains("NOPE"), "lookups also work at compile time");
+
+// Benchmark : command lookups in the compile time table against the dynamic map with transparent string keys
+void benchmark_static_map() {
+    const char* names[] = {"GET", "SET", "HGET", "ZRANGE", "QUIT", "NOPE", "SMEMBERS", "PING"};
+    UnorderedMap<string, int, StringHash, std::equal_to<>> dynamic_table;
+    for (const char* name : {"GET", "SET", "DEL", "EXISTS", "EXPIRE", "TTL", "INCR", "DECR", "MGET", "MSET", "HGET", "HSET", "HDEL",
+                             "LPUSH", "RPUSH", "LPOP", "RPOP", "LRANGE", "SADD", "SREM", "SMEMBERS", "ZADD", "ZRANGE", "PING",
+                             "ECHO", "AUTH", "SELECT", "FLUSHDB", "KEYS", "SCAN", "INFO", "QUIT"}) {
+        dynamic_table[name] = *kCommandTable.find(name);
+    }
+    std::vector<std::string_view> requests;
+    for (size_t i = 0; i < (1 << 22); ++i) {
+        requests.push_back(names[(i * 2654435761u) >> 7 & 7]);
+    }
+    long long checksum = 0;
+    double static_ms = time_ms([&] {
+        for (std::string_view name : requests) {
+            const int* id = kCommandTable.find(name);
+            checksum += id ? *id : 0;
+        }
+    });
+    double dynamic_ms = time_ms([&] {
+        for (std::string_view name : requests) {
+            const int* id = dynamic_table.find(name);
+            checksum += id ? *id : 0;
+        }
+    });
+    cout << "4M command lookups : static perfect map " << static_ms << " ms, UnorderedMap " << dynamic_ms << " ms (checksum "
+         << checksum << ")" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    /* Logic for Unordered Map implementation:
+    UnorderedMap
+   |
+   +-- buckets_ (index) : [ 2 | npos | 0 | ... ]   first entry of each bucket's chain
    |
-   +-- Vector of Buckets
-       |
-       +-- Bucket 0: [K1,V1] -> [K2,V2] -> nullptr
-       |
-       +-- Bucket 1: [K3,V3] -> nullptr
-       |
-   - Each Bucket is a linked list of KeyValuePairs
+   +-- entries_ (dense) : [K1,V1 next=npos] [K2,V2 next=npos] [K3,V3 next=0] [tombstone] ...
+                          in insertion order
+   - Compact dict layout : key-value pairs live in one dense array, buckets only hold entry indices
    - The hash function determines which bucket a key-value pair goes into
-   - Collisions are handled by adding to the same bucket (linked list)
-   - Keep track of number of elements and buckets (size_ and bucket_count_)
+   - Collisions are handled by chaining entries of the same bucket through their `next` index
+   - Erase leaves a tombstone, rehash compacts the array and rebuilds the index from cached hashes
+   - Iteration is a linear sweep of the dense array
+   - Keep track of number of elements and buckets (size_ and buckets_.size())
    - Use load factor to determine when to resize the hash table
    - Maintain max_load_factor to trigger resizing when exceeded
    - Allow updating of values for existing keys (insert_or_assign method)
@@ -255,6 +3470,25 @@ int main() {
     cout << map2.bucket_count(); // bucket_count
     cout << map2.load_factor(); // load_factor
     map2.max_load_factor(0.5); // max_load_factor
+    string key = "three";
+    map2.insert(std::move(key), 3); // rvalue insert : the key string is moved into the node
+    map2.try_emplace("four", 4); // try_emplace : value built in place only if "four" is absent
+    map2.emplace("five", 5); // emplace : key-value pair built in place
+    map2[string("six")] = 6; // operator[] with a temporary key moves it
+    for (int i = 0; i < 100; ++i) {
+        map2.insert_or_assign(to_string(i), i); // forces several rehashes, which only rebuild the bucket index
+    }
+    for (auto& pair : map2) { // range-for : linear sweep of the dense array, in insertion order
+        pair.value += 1;
+    }
+    int copied = 0;
+    for (auto pair : map2) { // range-for by value : each pair is a copy
+        copied += pair.value;
+    }
+    cout << copied;
+    long long total = 0;
+    map2.for_each([&total](const string& key, int& value) { total += value + key.size(); }); // for_each
+    cout << total;
     UnorderedMap<string, int> map3 = map2; // copy ctor
     UnorderedMap<string, int> map4;
     map4 = map2; // copy assignment
@@ -268,6 +3502,170 @@ int main() {
     UnorderedMap<string, int> map5 = std::move(map3); // move ctor
     UnorderedMap<string, int> map6;
     map6 = std::move(map5); // move assignment
+    cout << map5.load_factor() << map5.bucket_count(); // moved-from : empty, no buckets
+
+    UnorderedMap<int, int, std::hash<int>, std::equal_to<int>, ModuloBucketPolicy> map7(10); // bucket policy : legacy hash % bucket_count
+    UnorderedMap<int, int, std::hash<int>, std::equal_to<int>, FastRangeBucketPolicy> map8(10); // bucket policy : fastrange, any bucket count
+    map7.insert(1, 1);
+    map8.insert(1, 1);
+    cout << map7.bucket_count() << map8.bucket_count() << map1.bucket_count(); // 10 10 16 : power of two is the default policy
+
+    UnorderedMap<int, int> map9;
+    map9.insert_batch({{1, 10}, {2, 20}, {3, 30}}); // insert_batch : hashes the batch, grows once, prefetches while inserting
+    std::vector<const int*> values;
+    std::vector<bool> found;
+    cout << map9.find_batch({1, 4}, values) << *values[0]; // find_batch : pointers to values, nullptr for misses
+    cout << map9.contains_batch({2, 3, 5}, found) << found[2]; // contains_batch
+
+    UnorderedMap<int, int> map10(ExpectedSize{1000}); // ctor with expected element count : one allocation per array, no rehash
+    for (int i = 0; i < 1000; ++i) {
+        map10.insert(i, i);
+    }
+    cout << map10.bucket_count() << map10.capacity(); // 1024 1000 : unchanged by the 1000 inserts
+    map10.reserve(5000); // reserve : grows once to hold 5000 elements
+    for (int i = 0; i < 900; ++i) {
+        map10.erase(i);
+    }
+    map10.shrink_to_fit(); // shrink_to_fit : drops tombstones and fits both arrays to the 100 remaining elements
+    cout << map10.bucket_count() << map10.capacity();
+
+    UnorderedMap<int, int, std::hash<int>, std::equal_to<int>, PowerOfTwoBucketPolicy, MapStats> measured; // opt-in statistics
+    for (int i = 0; i < 1000; ++i) {
+        measured.insert(i * 1024, i);
+    }
+    measured.contains(5); // miss
+    measured.find(1024); // hit
+    measured.stats().print(cout); // hits/misses, probe length histogram, rehash count and time, load factor samples
+    cout << measured.max_chain_length() << measured.chain_length_histogram().size(); // chain length distribution
+    measured.reset_stats();
+    cout << sizeof(UnorderedMap<int, int>) << endl; // the default NoMapStats map records nothing
+
+    map10.move_to_back(950); // move_to_back : 950 becomes the newest element
+    cout << map10.pop_front()->key; // pop_front : removes the oldest element (900)
+
+    auto response_size = [](const string& url, const string& body) { return url.capacity() + body.capacity() + 64; };
+    LruCache<string, string, decltype(response_size)> responses(1024, response_size); // ctor with a byte budget
+    responses.put("/a", string(300, 'a')); // put
+    responses.put("/b", string(300, 'b'));
+    cout << (responses.get("/a") != nullptr); // get : hit, "/a" becomes most recently used
+    responses.put("/c", string(300, 'c')); // over budget : evicts "/b", the least recently used
+    cout << (responses.get("/b") == nullptr) << (responses.peek("/a") != nullptr); // miss , peek
+    cout << responses.stats().hits << responses.stats().misses << responses.stats().evictions; // counters : 1 1 1
+    cout << responses.size() << (responses.bytes() <= responses.max_bytes());
+
+    UnorderedMap<int, long long> prices;
+    prices.insert(7, 700);
+    prices.insert(8, 800);
+    write_snapshot(prices, "prices.snapshot"); // write_snapshot : flat open-addressing table on disk
+    {
+        MappedSnapshot<int, long long> mapped("prices.snapshot"); // ctor : mmap, no per-key work
+        cout << *mapped.find(7) << mapped.contains(9) << mapped.size(); // find , contains , size : read straight from the mapping
+    }
+    std::remove("prices.snapshot");
+
+    cout << *kCommandTable.find("GET") << kCommandTable.contains("NOPE") << kCommandTable.size(); // StaticPerfectMap : find , contains , size
+
+    std::stringstream checkpoint;
+    write_binary(map2, checkpoint); // write_binary : header then one record per pair, through a 64 KB buffer
+    UnorderedMap<string, int> restored;
+    read_binary(checkpoint, restored); // read_binary : reserves once, then inserts every record
+    cout << restored.size() << *restored.find("four"); // same pairs as map2
+
+    UnorderedMap<uint64_t, int, SeededHash> requests; // SeededHash : SipHash-1-3 with a per-map random secret
+    for (uint64_t key : make_colliding_keys(100)) {
+        requests.insert(key, 1); // these keys share one bucket under std::hash, here they spread out
+    }
+    cout << requests.size() << (requests.max_chain_length() <= 16);
+
+    TinyLfuCache<string, string> pages(1000, 8); // ctor with entry capacity and shard count
+    pages.put("/index", "<html>"); // put : enters the window segment
+    cout << pages.get("/index").value_or("miss"); // get : thread safe, returns a copy
+    cout << pages.get("/missing").has_value(); // miss
+    pages.erase("/index"); // erase
+    cout << pages.size() << pages.stats().hits << pages.stats().misses; // size , counters
+
+    UnorderedMap<string, int, StringHash, std::equal_to<>> routes; // transparent hash and equality : heterogeneous lookup
+    routes["/home"] = 1; // operator[] with a const char* : the string is only built because "/home" is inserted
+    std::string_view path = "/home";
+    cout << routes.contains(path); // contains with a string_view : no temporary std::string
+    cout << *routes.find("/home"); // find with a const char*
+    cout << routes["/home"]; // operator[] on an existing key : no allocation
+    routes.erase(path); // erase with a string_view
+
+    ConcurrentUnorderedMap<string, int> sessions(16); // ctor with shard count
+    sessions.insert("alice", 1); // insert : exclusive lock on one shard only
+    sessions.insert_or_assign("bob", 2); // insert_or_assign
+    cout << sessions.contains("alice"); // contains : shared lock
+    cout << sessions.find("bob").value_or(-1); // find : returns a copy
+    cout << sessions.compute_if_absent("carol", [] { return 3; }); // compute_if_absent : atomic find-or-create
+    sessions.update("carol", [](int& value) { value += 10; }); // update : atomic read-modify-write
+    sessions.erase("alice"); // erase
+    cout << sessions.size() << sessions.shard_count(); // size , shard_count
+
+    RcuUnorderedMap<string, int> config; // ctor : readers never lock
+    config.insert("timeout", 30); // insert
+    config.insert_or_assign("timeout", 60); // insert_or_assign : publishes a new node, the old one is retired
+    cout << config.contains("timeout"); // contains : wait-free
+    cout << config.find("timeout").value_or(-1); // find : wait-free, returns a copy
+    config.erase("timeout"); // erase
+    cout << config.size(); // size
+
+    UnorderedMap<string, int> totals;
+    totals.upsert("apples", [](int& total) { total += 5; }); // upsert : inserts 0 then applies the update
+    totals.upsert("apples", [](int& total) { total += 3; }); // upsert : updates in place
+    cout << totals["apples"]; // 8
+    CountingMap<string> words;
+    words.add("to"); // add : fused find-or-insert-and-increment
+    words.add_all({"be", "or", "not", "to", "be", "be"}); // add_all : batch through the prefetching pipeline
+    cout << words.count("be") << words.size() << words.total() << words.top(1)[0].first; // count , size , total , top
+    UnorderedMultiMap<string, int> orders;
+    orders.insert("alice", 1); // insert : values of a key are appended to its run
+    orders.insert("bob", 2);
+    orders.insert("alice", 3);
+    for (int order : orders.equal_range("alice")) { // equal_range : contiguous run of the values of one key
+        cout << order;
+    }
+    orders.for_each_group([](const string& key, const int*, size_t count) { cout << key << count; }); // for_each_group
+    cout << orders.count("alice") << orders.erase("alice") << orders.size() << orders.key_count(); // count , erase , size , key_count
+
+    PartitionedMap<string, int> inventory(4); // ctor with partition count
+    inventory.build({{"pen", 2}, {"ink", 1}, {"pen", 3}}, 2, [](int& total, int more) { total += more; }); // build : 2 threads, duplicates summed
+    UnorderedMap<string, int> shop1, shop2;
+    shop1.insert("ink", 4);
+    shop2.insert("cap", 1);
+    inventory.merge({&shop1, &shop2}, 2, [](int& total, int more) { total += more; }); // merge : parallel merge with combine
+    cout << *inventory.find("pen") << *inventory.find("ink") << inventory.contains("cap") << inventory.size(); // find , contains , size : 5 5 1 3
+
+    NodePool pool(sizeof(KeyValuePairDemo), 4); // NodePool : growable pool, chunk of 4 blocks then 8, 16, ...
+    std::vector<KeyValuePairDemo*> nodes;
+    for (int i = 0; i < 6; ++i) {
+        nodes.push_back(pool.create<KeyValuePairDemo>(KeyValuePairDemo{i, i * i})); // create : grows by one chunk on the 5th block
+    }
+    cout << pool.capacity() << pool.in_use(); // capacity , in_use : 12 6
+    for (KeyValuePairDemo* node : nodes) {
+        pool.destroy(node); // destroy : the block goes back to the free list
+    }
+    pool.release(); // release : every chunk freed at once
+
+    // Benchmarks only run on request : ./a.out --bench
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        cout << endl;
+        benchmark_bucket_policies();
+        benchmark_concurrent_map();
+        benchmark_rcu_map();
+        benchmark_batch_lookup(1 << 16);  // ~2.5 MB : fits in cache
+        benchmark_batch_lookup(1 << 22);  // ~200 MB : larger than the L3 of common servers
+        benchmark_caches();
+        benchmark_snapshot(1 << 16);
+        benchmark_snapshot(1 << 22);
+        benchmark_static_map();
+        benchmark_group_by(1 << 18);  // table fits in cache
+        benchmark_group_by(1 << 22);  // most keys are cold : the batch pipeline hides the misses
+        benchmark_parallel_build();
+        benchmark_binary_format(1 << 16);
+        benchmark_binary_format(1 << 22);
+        benchmark_seeded_hash();
+    }
 
     return 0;
 }
\ No newline at end of file
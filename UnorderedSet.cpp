@@ -1,193 +1,2593 @@
 #include <iostream>
 #include <vector>
-#include <list>
 #include <algorithm>
 #include <functional>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <chrono>
+#include <unordered_set>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cmath>
+#include <stdexcept>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
 using namespace std;
+/*
+    UnorderedSet : separate chaining over dense storage
+    - elements_ holds every element contiguously (no node per element), so iteration is a linear sweep
+    - links_[i] caches the full hash of elements_[i] and the index of the next element of the same bucket
+    - buckets_[b] is the index of the first element of bucket b's chain, npos when the bucket is empty
+    - erase moves the last element into the hole, so storage stays contiguous (element order is not kept)
+*/
 template <typename T>
 class UnorderedSet {
+public:
+    using value_type = T;
+    // Elements must not be modified in place (they would be left in the wrong bucket) : iterators are const
+    using iterator = typename std::vector<T>::const_iterator;
+    using const_iterator = iterator;
+
 private:
-    std::vector<std::list<T>>* buckets;
-    size_t size_;
-    size_t bucket_count_;
+    static constexpr size_t npos = static_cast<size_t>(-1); // end of a chain, or an empty bucket
+
+    struct Link {
+        size_t hash; // full hash, cached so rehash never calls std::hash again
+        size_t next; // next element of the same bucket, npos at the end of the chain
+    };
+
+    std::vector<T> elements_;
+    std::vector<Link> links_;
+    std::vector<size_t> buckets_;
     float max_load_factor_;
 
-    // Hash function
-    size_t hash(const T& key) const {
-        return std::hash<T>{}(key) % bucket_count_;
+    // Hash function
+    size_t bucket_for(size_t full_hash) const {
+        return full_hash % buckets_.size();
+    }
+    // this returns the index of the element equal to key, or npos
+    size_t find_index(const T& key, size_t full_hash) const {
+        for (size_t i = buckets_[bucket_for(full_hash)]; i != npos; i = links_[i].next) {
+            if (links_[i].hash == full_hash && elements_[i] == key) { // cached hash first : most mismatches never touch the element
+                return i;
+            }
+        }
+        return npos;
+    }
+    // Link (bucket head or an element's next) that points at element i
+    size_t* link_to(size_t i) {
+        size_t* link = &buckets_[bucket_for(links_[i].hash)];
+        while (*link != i) {
+            link = &links_[*link].next;
+        }
+        return link;
+    }
+
+    // Resize the hash table : only the chains are rebuilt, from the cached hashes ; elements do not move
+    void rehash(size_t new_bucket_count) {
+        buckets_.assign(std::max<size_t>(new_bucket_count, 1), npos);
+        for (size_t i = 0; i < links_.size(); ++i) {
+            size_t& head = buckets_[bucket_for(links_[i].hash)];
+            links_[i].next = head;
+            head = i;
+        }
+    }
+
+    // Remove element i : unlink it, then move the last element into its place
+    void erase_at(size_t i) {
+        *link_to(i) = links_[i].next;
+        size_t last = elements_.size() - 1;
+        if (i != last) {
+            *link_to(last) = i;
+            elements_[i] = std::move(elements_[last]);
+            links_[i] = links_[last];
+        }
+        elements_.pop_back();
+        links_.pop_back();
+    }
+
+public:
+    // 1. Default constructor
+    UnorderedSet() : UnorderedSet(10) {}
+
+    // 2. Constructor with initial bucket count
+    explicit UnorderedSet(size_t bucket_count) : buckets_(std::max<size_t>(bucket_count, 1), npos), max_load_factor_(1.0) {}
+
+    // 3. Insert an element
+    bool insert(const T& key) {
+        if (buckets_.empty()) { // moved-from set
+            rehash(10);
+        }
+        size_t full_hash = std::hash<T>{}(key);
+        if (find_index(key, full_hash) != npos) {
+            return false;
+        }
+        size_t& head = buckets_[bucket_for(full_hash)];
+        elements_.push_back(key);
+        links_.push_back(Link{full_hash, head});
+        head = elements_.size() - 1;
+        if (elements_.size() > buckets_.size() * max_load_factor_) {
+            rehash(buckets_.size() * 2);
+        }
+        return true;
+    }
+
+    // 4. Remove an element
+    bool erase(const T& key) {
+        if (elements_.empty()) {
+            return false;
+        }
+        size_t i = find_index(key, std::hash<T>{}(key));
+        if (i == npos) {
+            return false;
+        }
+        erase_at(i);
+        return true;
+    }
+
+    // 4. Remove the element at pos : returns the iterator to continue from, so a set can be erased from while it is walked
+    //   for (auto it = set.begin(); it != set.end();) it = drop(*it) ? set.erase(it) : std::next(it);
+    //   the last element moves into pos, so it is visited next and every element is still seen exactly once
+    iterator erase(const_iterator pos) {
+        size_t i = static_cast<size_t>(pos - elements_.cbegin());
+        erase_at(i);
+        return elements_.cbegin() + i;
+    }
+
+    // 4. Remove every element for which pred(element) is true in one pass : survivors are packed to the front, then
+    //    the chains are rebuilt once ; returns the number of elements removed
+    template <typename Pred>
+    size_t erase_if(Pred pred) {
+        size_t out = 0;
+        for (size_t in = 0; in < elements_.size(); ++in) {
+            if (!pred(static_cast<const T&>(elements_[in]))) {
+                if (out != in) {
+                    elements_[out] = std::move(elements_[in]);
+                    links_[out] = links_[in];
+                }
+                ++out;
+            }
+        }
+        size_t removed = elements_.size() - out;
+        if (removed != 0) {
+            elements_.erase(elements_.begin() + out, elements_.end());
+            links_.resize(out);
+            rehash(buckets_.size());
+        }
+        return removed;
+    }
+
+    // 5. Check if an element exists
+    bool contains(const T& key) const {
+        return !elements_.empty() && find_index(key, std::hash<T>{}(key)) != npos;
+    }
+
+    // 5. Hint that key is about to be looked up : starts loading its bucket, used by the batched set algebra
+    void prefetch(const T& key) const {
+        if (!buckets_.empty()) {
+            __builtin_prefetch(&buckets_[bucket_for(std::hash<T>{}(key))]);
+        }
+    }
+
+    // 5. Visit every element (storage order)
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        for (const T& element : elements_) {
+            fn(element);
+        }
+    }
+
+    // 5. Iteration over the contiguous storage : for (const auto& element : set) ; invalidated by insert and erase
+    //    (except the iterator returned by erase)
+    const_iterator begin() const { return elements_.cbegin(); }
+    const_iterator end() const { return elements_.cend(); }
+
+    // 6. Get the number of elements
+    size_t size() const {
+        return elements_.size();
+    }
+
+    // 7. Check if the set is empty
+    bool empty() const {
+        return elements_.empty();
+    }
+
+    // 8. Clear the set : storage and buckets keep their capacity
+    void clear() {
+        elements_.clear();
+        links_.clear();
+        std::fill(buckets_.begin(), buckets_.end(), npos);
+    }
+
+    // 9. Get the number of buckets
+    size_t bucket_count() const {
+        return buckets_.size();
+    }
+
+    // 10. Get the current load factor : 0 for a moved-from set, which has no buckets
+    float load_factor() const {
+        return buckets_.empty() ? 0.0f : static_cast<float>(elements_.size()) / buckets_.size();
+    }
+
+    // 11. Set the maximum load factor
+    void max_load_factor(float mlf) {
+        max_load_factor_ = mlf;
+        if (load_factor() > max_load_factor_) {
+            rehash(elements_.size() / max_load_factor_ + 1);
+        }
+    }
+
+    // 11. Make room for count elements : no reallocation and no rehash until the set holds more than count elements
+    void reserve(size_t count) {
+        size_t needed = static_cast<size_t>(std::ceil(count / max_load_factor_));
+        if (needed > buckets_.size()) {
+            rehash(needed);
+        }
+        elements_.reserve(count);
+        links_.reserve(count);
+    }
+
+    // 12. Copy constructor , 13. Copy assignment operator : the three arrays are copied as they are
+    UnorderedSet(const UnorderedSet& other) = default;
+    UnorderedSet& operator=(const UnorderedSet& other) = default;
+
+    // Move constructor , move assignment operator : other is left empty without buckets, its next insert recreates them
+    UnorderedSet(UnorderedSet&& other) noexcept = default;
+    UnorderedSet& operator=(UnorderedSet&& other) noexcept = default;
+
+    // Destructor : the vectors free the elements and the index
+    ~UnorderedSet() = default;
+};
+
+/*
+    FlatUnorderedSet : open addressing set, every element stored inline in one slot array (no node per element)
+    Swiss table layout :
+    - one control byte per slot : kEmpty, kDeleted, or h2 (the 7 low bits of the mixed hash) when the slot is full
+    - slots are searched 16 at a time (a group) : one SSE2 compare of h2 against the 16 control bytes gives the
+      candidate slots, so a lookup usually compares one element, and a miss usually compares none
+    - groups are visited in triangular order (+1, +2, +3 ... groups), which covers every group of a power-of-two table
+    - a search stops at the first group with an empty slot, so erase only leaves a kDeleted tombstone in a full group
+    - the table grows at 7/8 load ; once tombstones eat the free slots it is rebuilt at the same size instead
+*/
+template <typename T, typename Hash = std::hash<T>, typename KeyEqual = std::equal_to<T>>
+class FlatUnorderedSet {
+public:
+    using value_type = T;
+
+private:
+    static constexpr size_t kGroupSize = 16;
+    static constexpr int8_t kEmpty = -128;  // 0b10000000
+    static constexpr int8_t kDeleted = -2;  // 0b11111110 , a full slot holds 0b0xxxxxxx
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    int8_t* ctrl_;         // capacity_ control bytes
+    T* slots_;             // capacity_ slots, constructed only where the control byte is full
+    size_t capacity_;      // 0 or a power of two >= kGroupSize
+    size_t size_;
+    size_t growth_left_;   // empty slots that may still be filled before the table must be rebuilt
+    Hash hasher_;
+    KeyEqual key_eq_;
+
+    // std::hash is the identity for integers : fold a 128-bit multiply so that both h1 and h2 depend on every bit
+    size_t mixed_hash(const T& key) const {
+        unsigned __int128 product = static_cast<unsigned __int128>(hasher_(key)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64));
+    }
+
+    // Bit i of the result is set when control byte i of the group equals value
+    static uint32_t match(const int8_t* group, int8_t value) {
+#if defined(__SSE2__)
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(value))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < kGroupSize; ++i) {
+            mask |= static_cast<uint32_t>(group[i] == value) << i;
+        }
+        return mask;
+#endif
+    }
+
+    // Bit i set when slot i of the group is empty or deleted (both are below -1, full bytes are >= 0)
+    static uint32_t match_free(const int8_t* group) {
+#if defined(__SSE2__)
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmplt_epi8(bytes, _mm_set1_epi8(-1))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < kGroupSize; ++i) {
+            mask |= static_cast<uint32_t>(group[i] < -1) << i;
+        }
+        return mask;
+#endif
+    }
+
+    static size_t max_elements(size_t capacity) {
+        return capacity - capacity / 8;
+    }
+
+    // Slot holding key, npos if absent
+    size_t find_slot(const T& key, size_t hash) const {
+        if (capacity_ == 0) {
+            return npos;
+        }
+        size_t group_mask = capacity_ / kGroupSize - 1;
+        size_t group = (hash >> 7) & group_mask;
+        int8_t h2 = static_cast<int8_t>(hash & 0x7F);
+        for (size_t step = 1;; ++step) {
+            const int8_t* ctrl = ctrl_ + group * kGroupSize;
+            for (uint32_t candidates = match(ctrl, h2); candidates != 0; candidates &= candidates - 1) {
+                size_t i = group * kGroupSize + __builtin_ctz(candidates);
+                if (key_eq_(slots_[i], key)) {
+                    return i;
+                }
+            }
+            if (match(ctrl, kEmpty) != 0) {
+                return npos; // key would have been placed in this group
+            }
+            group = (group + step) & group_mask;
+        }
+    }
+
+    // First empty or deleted slot of hash's probe sequence : where a new element goes
+    size_t find_free_slot(size_t hash) const {
+        size_t group_mask = capacity_ / kGroupSize - 1;
+        size_t group = (hash >> 7) & group_mask;
+        for (size_t step = 1;; ++step) {
+            uint32_t free_slots = match_free(ctrl_ + group * kGroupSize);
+            if (free_slots != 0) {
+                return group * kGroupSize + __builtin_ctz(free_slots);
+            }
+            group = (group + step) & group_mask;
+        }
+    }
+
+    // Move every element into fresh arrays of new_capacity slots (also drops every tombstone)
+    void resize(size_t new_capacity) {
+        int8_t* old_ctrl = ctrl_;
+        T* old_slots = slots_;
+        size_t old_capacity = capacity_;
+        ctrl_ = new int8_t[new_capacity];
+        std::memset(ctrl_, kEmpty, new_capacity);
+        slots_ = std::allocator<T>().allocate(new_capacity);
+        capacity_ = new_capacity;
+        growth_left_ = max_elements(new_capacity) - size_;
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (old_ctrl[i] >= 0) {
+                size_t hash = mixed_hash(old_slots[i]);
+                size_t slot = find_free_slot(hash);
+                new (slots_ + slot) T(std::move(old_slots[i]));
+                ctrl_[slot] = static_cast<int8_t>(hash & 0x7F);
+                old_slots[i].~T();
+            }
+        }
+        release(old_ctrl, old_slots, old_capacity);
+    }
+
+    static void release(int8_t* ctrl, T* slots, size_t capacity) {
+        delete[] ctrl;
+        if (slots != nullptr) {
+            std::allocator<T>().deallocate(slots, capacity);
+        }
+    }
+
+    void destroy_elements() {
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (ctrl_[i] >= 0) {
+                slots_[i].~T();
+            }
+        }
+    }
+
+public:
+    // 1. Default constructor : no allocation until the first insert
+    FlatUnorderedSet() : ctrl_(nullptr), slots_(nullptr), capacity_(0), size_(0), growth_left_(0) {}
+
+    // 2. Constructor sized for count elements without rebuilding
+    explicit FlatUnorderedSet(size_t count) : FlatUnorderedSet() {
+        reserve(count);
+    }
+
+    // 3. Insert an element
+    bool insert(const T& key) {
+        size_t hash = mixed_hash(key);
+        if (find_slot(key, hash) != npos) {
+            return false;
+        }
+        if (capacity_ == 0) {
+            resize(kGroupSize);
+        }
+        size_t slot = find_free_slot(hash);
+        if (ctrl_[slot] == kEmpty && growth_left_ == 0) { // a deleted slot can be reused for free, an empty one costs growth
+            resize(size_ + 1 > max_elements(capacity_) / 2 ? capacity_ * 2 : capacity_); // mostly tombstones : same size rebuild
+            slot = find_free_slot(hash);
+        }
+        new (slots_ + slot) T(key);
+        growth_left_ -= ctrl_[slot] == kEmpty;
+        ctrl_[slot] = static_cast<int8_t>(hash & 0x7F);
+        ++size_;
+        return true;
+    }
+
+    // 4. Remove an element
+    bool erase(const T& key) {
+        size_t slot = find_slot(key, mixed_hash(key));
+        if (slot == npos) {
+            return false;
+        }
+        slots_[slot].~T();
+        const int8_t* group = ctrl_ + slot / kGroupSize * kGroupSize;
+        if (match(group, kEmpty) != 0) { // searches already stop at this group : the slot can become empty again
+            ctrl_[slot] = kEmpty;
+            ++growth_left_;
+        } else {
+            ctrl_[slot] = kDeleted;
+        }
+        --size_;
+        return true;
+    }
+
+    // 5. Check if an element exists
+    bool contains(const T& key) const {
+        return find_slot(key, mixed_hash(key)) != npos;
+    }
+
+    // 5. Hint that key is about to be looked up : starts loading the control bytes and slots of its first group
+    void prefetch(const T& key) const {
+        if (capacity_ != 0) {
+            size_t group = (mixed_hash(key) >> 7) & (capacity_ / kGroupSize - 1);
+            __builtin_prefetch(ctrl_ + group * kGroupSize);
+            __builtin_prefetch(slots_ + group * kGroupSize);
+        }
+    }
+
+    // 5. Visit every element (slot order)
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (ctrl_[i] >= 0) {
+                fn(slots_[i]);
+            }
+        }
+    }
+
+    // 6. Get the number of elements
+    size_t size() const {
+        return size_;
+    }
+
+    // 7. Check if the set is empty
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // 8. Clear the set : the slot array is kept
+    void clear() {
+        destroy_elements();
+        if (capacity_ != 0) {
+            std::memset(ctrl_, kEmpty, capacity_);
+        }
+        size_ = 0;
+        growth_left_ = max_elements(capacity_);
+    }
+
+    // 9. Get the number of slots
+    size_t bucket_count() const {
+        return capacity_;
+    }
+
+    // 10. Get the current load factor (the maximum is fixed at 7/8)
+    float load_factor() const {
+        return capacity_ == 0 ? 0.0f : static_cast<float>(size_) / capacity_;
+    }
+
+    // 11. Make room for count elements
+    void reserve(size_t count) {
+        size_t capacity = kGroupSize;
+        while (max_elements(capacity) < count) {
+            capacity *= 2;
+        }
+        if (capacity > capacity_) {
+            resize(capacity);
+        }
+    }
+
+    // 12. Get the bytes owned by the set : one control byte and one slot per slot
+    size_t memory_bytes() const {
+        return capacity_ * (1 + sizeof(T));
+    }
+
+    // 13. Copy constructor : same layout, only the full slots are copied
+    FlatUnorderedSet(const FlatUnorderedSet& other)
+        : ctrl_(nullptr), slots_(nullptr), capacity_(0), size_(0), growth_left_(0), hasher_(other.hasher_), key_eq_(other.key_eq_) {
+        if (other.capacity_ == 0) {
+            return;
+        }
+        ctrl_ = new int8_t[other.capacity_];
+        std::memset(ctrl_, kEmpty, other.capacity_);
+        slots_ = std::allocator<T>().allocate(other.capacity_);
+        capacity_ = other.capacity_;
+        try {
+            for (size_t i = 0; i < capacity_; ++i) {
+                if (other.ctrl_[i] >= 0) {
+                    new (slots_ + i) T(other.slots_[i]);
+                    ctrl_[i] = other.ctrl_[i];
+                }
+            }
+        } catch (...) {
+            destroy_elements();
+            release(ctrl_, slots_, capacity_);
+            throw;
+        }
+        std::memcpy(ctrl_, other.ctrl_, capacity_); // tombstones too, so growth_left_ stays consistent
+        size_ = other.size_;
+        growth_left_ = other.growth_left_;
+    }
+
+    // 14. Copy assignment operator
+    FlatUnorderedSet& operator=(const FlatUnorderedSet& other) {
+        if (this != &other) {
+            FlatUnorderedSet copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    // Move constructor : steals both arrays
+    FlatUnorderedSet(FlatUnorderedSet&& other) noexcept
+        : ctrl_(other.ctrl_), slots_(other.slots_), capacity_(other.capacity_), size_(other.size_), growth_left_(other.growth_left_),
+          hasher_(std::move(other.hasher_)), key_eq_(std::move(other.key_eq_)) {
+        other.ctrl_ = nullptr;
+        other.slots_ = nullptr;
+        other.capacity_ = 0;
+        other.size_ = 0;
+        other.growth_left_ = 0;
+    }
+
+    // Move assignment operator
+    FlatUnorderedSet& operator=(FlatUnorderedSet&& other) noexcept {
+        if (this != &other) {
+            destroy_elements();
+            release(ctrl_, slots_, capacity_);
+            ctrl_ = other.ctrl_;
+            slots_ = other.slots_;
+            capacity_ = other.capacity_;
+            size_ = other.size_;
+            growth_left_ = other.growth_left_;
+            hasher_ = std::move(other.hasher_);
+            key_eq_ = std::move(other.key_eq_);
+            other.ctrl_ = nullptr;
+            other.slots_ = nullptr;
+            other.capacity_ = 0;
+            other.size_ = 0;
+            other.growth_left_ = 0;
+        }
+        return *this;
+    }
+
+    // Destructor : destroys the elements of the full slots, then frees both arrays
+    ~FlatUnorderedSet() {
+        destroy_elements();
+        release(ctrl_, slots_, capacity_);
+    }
+};
+
+/*
+    RoaringSet : compressed set of 32-bit integers for dense ID ranges (Roaring bitmap layout)
+    - the value space is cut in 64K chunks by the high 16 bits ; only chunks holding a value exist, sorted by key
+    - each chunk keeps its low 16 bits in whichever container is smallest :
+      array  : sorted uint16_t values, up to kArrayMax of them (2 bytes per value)
+      bitmap : 65536 bits in 1024 words (8 KB flat), for more values
+      runs   : sorted [start, start + length] intervals (4 bytes per interval), for long consecutive ranges
+    - insert / erase move between array and bitmap on their own ; insert_range and optimize() produce runs
+    - union / intersection / difference go chunk by chunk : bitmap pairs are combined 128 bits at a time (SSE2),
+      array pairs are merged, an array against a bitmap tests bits ; run containers are expanded first
+*/
+class RoaringSet {
+private:
+    static constexpr size_t kArrayMax = 4096;     // above this an array is bigger than a bitmap
+    static constexpr size_t kBitmapWords = 1024;
+
+    struct Run {
+        uint16_t start;
+        uint16_t length; // the run holds start .. start + length
+    };
+
+    enum class Kind : uint8_t { Array, Bitmap, Runs };
+    enum class BitOp { And, Or, AndNot };
+
+    struct Container {
+        Kind kind = Kind::Array;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> array;
+        std::vector<uint64_t> bitmap;
+        std::vector<Run> runs;
+
+        bool test_bit(uint16_t value) const {
+            return (bitmap[value >> 6] >> (value & 63)) & 1;
+        }
+
+        // Visit every value in ascending order
+        template <typename Fn>
+        void for_each(Fn fn) const {
+            if (kind == Kind::Array) {
+                for (uint16_t value : array) {
+                    fn(value);
+                }
+            } else if (kind == Kind::Bitmap) {
+                for (size_t w = 0; w < kBitmapWords; ++w) {
+                    for (uint64_t word = bitmap[w]; word != 0; word &= word - 1) {
+                        fn(static_cast<uint16_t>(w * 64 + __builtin_ctzll(word)));
+                    }
+                }
+            } else {
+                for (const Run& run : runs) {
+                    for (uint32_t value = run.start; value <= uint32_t(run.start) + run.length; ++value) {
+                        fn(static_cast<uint16_t>(value));
+                    }
+                }
+            }
+        }
+
+        // Index of the run that starts at or before value (runs.size() if none)
+        size_t run_before(uint16_t value) const {
+            size_t i = std::upper_bound(runs.begin(), runs.end(), value, [](uint16_t v, const Run& r) { return v < r.start; }) - runs.begin();
+            return i == 0 ? runs.size() : i - 1;
+        }
+
+        bool contains(uint16_t value) const {
+            if (kind == Kind::Array) {
+                return std::binary_search(array.begin(), array.end(), value);
+            }
+            if (kind == Kind::Bitmap) {
+                return test_bit(value);
+            }
+            size_t i = run_before(value);
+            return i != runs.size() && value <= uint32_t(runs[i].start) + runs[i].length;
+        }
+
+        void to_bitmap() {
+            if (kind == Kind::Bitmap) {
+                return; // already one : rebuilding from the (empty) array would drop every value
+            }
+            std::vector<uint64_t> bits(kBitmapWords, 0);
+            if (kind == Kind::Runs) {
+                for (const Run& run : runs) {
+                    set_range(bits.data(), run.start, uint32_t(run.start) + run.length);
+                }
+            } else {
+                for (uint16_t value : array) {
+                    bits[value >> 6] |= uint64_t(1) << (value & 63);
+                }
+            }
+            array = std::vector<uint16_t>();
+            runs = std::vector<Run>();
+            bitmap = std::move(bits);
+            kind = Kind::Bitmap;
+        }
+
+        void to_array() {
+            std::vector<uint16_t> values;
+            values.reserve(cardinality);
+            for_each([&values](uint16_t value) { values.push_back(value); });
+            bitmap = std::vector<uint64_t>();
+            runs = std::vector<Run>();
+            array = std::move(values);
+            kind = Kind::Array;
+        }
+
+        void to_runs() {
+            std::vector<Run> intervals;
+            if (kind == Kind::Bitmap) { // word at a time : find the next set bit, then the next clear bit
+                uint32_t position = 0;
+                while (position < 65536) {
+                    size_t w = position >> 6;
+                    uint64_t word = bitmap[w] & (~uint64_t(0) << (position & 63));
+                    while (word == 0 && ++w < kBitmapWords) {
+                        word = bitmap[w];
+                    }
+                    if (word == 0) {
+                        break;
+                    }
+                    uint32_t start = static_cast<uint32_t>(w * 64 + __builtin_ctzll(word));
+                    word = ~bitmap[w] & (~uint64_t(0) << (start & 63));
+                    while (word == 0 && ++w < kBitmapWords) {
+                        word = ~bitmap[w];
+                    }
+                    position = word == 0 ? 65536 : static_cast<uint32_t>(w * 64 + __builtin_ctzll(word));
+                    intervals.push_back({static_cast<uint16_t>(start), static_cast<uint16_t>(position - 1 - start)});
+                }
+            } else {
+                for_each([&intervals](uint16_t value) {
+                    if (!intervals.empty() && uint32_t(intervals.back().start) + intervals.back().length + 1 == value) {
+                        ++intervals.back().length;
+                    } else {
+                        intervals.push_back({value, 0});
+                    }
+                });
+            }
+            array = std::vector<uint16_t>();
+            bitmap = std::vector<uint64_t>();
+            runs = std::move(intervals);
+            kind = Kind::Runs;
+        }
+
+        // Array or bitmap, whichever fits the cardinality : the form set operations work on
+        void to_classic() {
+            if (cardinality <= kArrayMax) {
+                if (kind != Kind::Array) to_array();
+            } else if (kind != Kind::Bitmap) {
+                to_bitmap();
+            }
+        }
+
+        size_t count_runs() const {
+            if (kind == Kind::Runs) {
+                return runs.size();
+            }
+            if (kind == Kind::Array) {
+                size_t count = 0;
+                for (size_t i = 0; i < array.size(); ++i) {
+                    count += i == 0 || array[i] != array[i - 1] + 1;
+                }
+                return count;
+            }
+            size_t count = 0;
+            uint64_t carry = 0; // last bit of the previous word
+            for (size_t w = 0; w < kBitmapWords; ++w) {
+                count += __builtin_popcountll(bitmap[w] & ~((bitmap[w] << 1) | carry)); // bits whose predecessor is 0 start a run
+                carry = bitmap[w] >> 63;
+            }
+            return count;
+        }
+
+        // Switch to the smallest of the three containers
+        void optimize() {
+            size_t run_bytes = count_runs() * sizeof(Run);
+            size_t classic_bytes = cardinality <= kArrayMax ? cardinality * sizeof(uint16_t) : kBitmapWords * sizeof(uint64_t);
+            if (run_bytes < classic_bytes) {
+                if (kind != Kind::Runs) to_runs();
+            } else {
+                to_classic();
+            }
+            array.shrink_to_fit();
+            runs.shrink_to_fit();
+        }
+
+        bool insert(uint16_t value) {
+            if (kind == Kind::Array) {
+                auto it = std::lower_bound(array.begin(), array.end(), value);
+                if (it != array.end() && *it == value) {
+                    return false;
+                }
+                if (array.size() < kArrayMax) {
+                    array.insert(it, value);
+                    ++cardinality;
+                    return true;
+                }
+                to_bitmap(); // a full array becomes a bitmap, then the bit is set below
+            }
+            if (kind == Kind::Bitmap) {
+                uint64_t& word = bitmap[value >> 6];
+                uint64_t bit = uint64_t(1) << (value & 63);
+                if (word & bit) {
+                    return false;
+                }
+                word |= bit;
+                ++cardinality;
+                return true;
+            }
+            size_t i = run_before(value);
+            if (i != runs.size() && value <= uint32_t(runs[i].start) + runs[i].length) {
+                return false;
+            }
+            size_t next = i == runs.size() ? 0 : i + 1;
+            bool joins_previous = i != runs.size() && uint32_t(runs[i].start) + runs[i].length + 1 == value;
+            bool joins_next = next < runs.size() && uint32_t(value) + 1 == runs[next].start;
+            if (joins_previous && joins_next) { // value fills the gap between two runs
+                runs[i].length += runs[next].length + 2;
+                runs.erase(runs.begin() + next);
+            } else if (joins_previous) {
+                ++runs[i].length;
+            } else if (joins_next) {
+                --runs[next].start;
+                ++runs[next].length;
+            } else {
+                runs.insert(runs.begin() + next, Run{value, 0});
+            }
+            ++cardinality;
+            return true;
+        }
+
+        bool erase(uint16_t value) {
+            if (kind == Kind::Array) {
+                auto it = std::lower_bound(array.begin(), array.end(), value);
+                if (it == array.end() || *it != value) {
+                    return false;
+                }
+                array.erase(it);
+                --cardinality;
+                return true;
+            }
+            if (kind == Kind::Bitmap) {
+                uint64_t& word = bitmap[value >> 6];
+                uint64_t bit = uint64_t(1) << (value & 63);
+                if (!(word & bit)) {
+                    return false;
+                }
+                word &= ~bit;
+                if (--cardinality <= kArrayMax / 2) { // hysteresis : no back and forth around kArrayMax
+                    to_array();
+                }
+                return true;
+            }
+            size_t i = run_before(value);
+            if (i == runs.size() || value > uint32_t(runs[i].start) + runs[i].length) {
+                return false;
+            }
+            Run& run = runs[i];
+            uint32_t end = uint32_t(run.start) + run.length;
+            if (run.length == 0) {
+                runs.erase(runs.begin() + i);
+            } else if (value == run.start) {
+                ++run.start;
+                --run.length;
+            } else if (value == end) {
+                --run.length;
+            } else { // split in two
+                Run tail{static_cast<uint16_t>(value + 1), static_cast<uint16_t>(end - value - 1)};
+                run.length = static_cast<uint16_t>(value - run.start - 1);
+                runs.insert(runs.begin() + i + 1, tail);
+            }
+            --cardinality;
+            return true;
+        }
+
+        size_t memory_bytes() const {
+            return array.capacity() * sizeof(uint16_t) + bitmap.capacity() * sizeof(uint64_t) + runs.capacity() * sizeof(Run);
+        }
+    };
+
+    struct Chunk {
+        uint16_t key;   // high 16 bits of every value of the chunk
+        Container container;
+    };
+
+    std::vector<Chunk> chunks_;
+    size_t size_;
+
+    // Set bits first .. last (inclusive) of a 1024-word bitmap
+    static void set_range(uint64_t* bits, uint32_t first, uint32_t last) {
+        for (uint32_t w = first >> 6; w <= (last >> 6); ++w) {
+            uint64_t mask = ~uint64_t(0);
+            if (w == (first >> 6)) mask &= ~uint64_t(0) << (first & 63);
+            if (w == (last >> 6)) mask &= ~uint64_t(0) >> (63 - (last & 63));
+            bits[w] |= mask;
+        }
+    }
+
+    // out = a op b over two bitmaps, 128 bits per step with SSE2 ; returns the number of bits set in out
+    template <BitOp Op>
+    static uint32_t combine_bitmaps(const uint64_t* a, const uint64_t* b, uint64_t* out) {
+        uint32_t cardinality = 0;
+        for (size_t w = 0; w < kBitmapWords; w += 2) {
+#if defined(__SSE2__)
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + w));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + w));
+            __m128i r = Op == BitOp::And ? _mm_and_si128(x, y) : Op == BitOp::Or ? _mm_or_si128(x, y) : _mm_andnot_si128(y, x);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + w), r);
+#else
+            for (size_t k = w; k < w + 2; ++k) {
+                out[k] = Op == BitOp::And ? a[k] & b[k] : Op == BitOp::Or ? a[k] | b[k] : a[k] & ~b[k];
+            }
+#endif
+            cardinality += __builtin_popcountll(out[w]) + __builtin_popcountll(out[w + 1]);
+        }
+        return cardinality;
+    }
+
+    // Container level set operation, both inputs already in array or bitmap form
+    template <BitOp Op>
+    static Container combine(const Container& a, const Container& b) {
+        Container result;
+        if (a.kind == Kind::Bitmap && b.kind == Kind::Bitmap) {
+            result.kind = Kind::Bitmap;
+            result.bitmap.resize(kBitmapWords);
+            result.cardinality = combine_bitmaps<Op>(a.bitmap.data(), b.bitmap.data(), result.bitmap.data());
+        } else if (a.kind == Kind::Array && b.kind == Kind::Array) {
+            auto out = std::back_inserter(result.array);
+            if (Op == BitOp::And) {
+                std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), out);
+            } else if (Op == BitOp::Or) {
+                result.array.reserve(a.array.size() + b.array.size());
+                std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), out);
+            } else {
+                std::set_difference(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), out);
+            }
+            result.cardinality = static_cast<uint32_t>(result.array.size());
+        } else if (Op == BitOp::And || (Op == BitOp::AndNot && a.kind == Kind::Array)) {
+            const Container& values = a.kind == Kind::Array ? a : b; // the array is filtered through the bitmap's bits
+            const Container& bits = a.kind == Kind::Array ? b : a;
+            bool keep_if_set = Op == BitOp::And;
+            for (uint16_t value : values.array) {
+                if (bits.test_bit(value) == keep_if_set) {
+                    result.array.push_back(value);
+                }
+            }
+            result.cardinality = static_cast<uint32_t>(result.array.size());
+        } else { // bitmap | array , array | bitmap , bitmap - array : start from the bitmap, flip the array's bits
+            const Container& bits = a.kind == Kind::Bitmap ? a : b;
+            const Container& values = a.kind == Kind::Bitmap ? b : a;
+            result.kind = Kind::Bitmap;
+            result.bitmap = bits.bitmap;
+            result.cardinality = bits.cardinality;
+            for (uint16_t value : values.array) {
+                uint64_t& word = result.bitmap[value >> 6];
+                uint64_t bit = uint64_t(1) << (value & 63);
+                if (Op == BitOp::Or && !(word & bit)) {
+                    word |= bit;
+                    ++result.cardinality;
+                } else if (Op == BitOp::AndNot && (word & bit)) {
+                    word &= ~bit;
+                    --result.cardinality;
+                }
+            }
+        }
+        if (result.kind == Kind::Array && result.cardinality > kArrayMax) {
+            result.to_bitmap();
+        } else if (result.kind == Kind::Bitmap && result.cardinality <= kArrayMax) {
+            result.to_array();
+        }
+        return result;
+    }
+
+    // Chunk by chunk set operation : a chunk of one side only is kept for Or, kept from the left side for AndNot
+    template <BitOp Op>
+    void combine_with(const RoaringSet& other) {
+        if (&other == this) { // the loop below moves chunks out of *this : a |= a and a &= a keep a, a -= a empties it
+            if (Op == BitOp::AndNot) {
+                clear();
+            }
+            return;
+        }
+        std::vector<Chunk> result;
+        size_t i = 0, j = 0;
+        while (i < chunks_.size() || j < other.chunks_.size()) {
+            bool left = j == other.chunks_.size() || (i < chunks_.size() && chunks_[i].key < other.chunks_[j].key);
+            bool right = i == chunks_.size() || (j < other.chunks_.size() && other.chunks_[j].key < chunks_[i].key);
+            if (left) {
+                if (Op != BitOp::And) result.push_back(std::move(chunks_[i]));
+                ++i;
+            } else if (right) {
+                if (Op == BitOp::Or) result.push_back(other.chunks_[j]);
+                ++j;
+            } else {
+                Container a = std::move(chunks_[i].container);
+                Container b_copy;
+                const Container* b = &other.chunks_[j].container;
+                a.to_classic();
+                if (b->kind == Kind::Runs) {
+                    b_copy = *b;
+                    b_copy.to_classic();
+                    b = &b_copy;
+                }
+                Container combined = combine<Op>(a, *b);
+                if (combined.cardinality != 0) {
+                    result.push_back({chunks_[i].key, std::move(combined)});
+                }
+                ++i;
+                ++j;
+            }
+        }
+        chunks_ = std::move(result);
+        size_ = 0;
+        for (const Chunk& chunk : chunks_) {
+            size_ += chunk.container.cardinality;
+        }
+    }
+
+    // Chunk of key : lower_bound position in the sorted chunk list
+    size_t chunk_position(uint16_t key) const {
+        return std::lower_bound(chunks_.begin(), chunks_.end(), key, [](const Chunk& c, uint16_t k) { return c.key < k; }) - chunks_.begin();
+    }
+
+    Container& chunk_for_insert(uint16_t key) {
+        size_t at = chunk_position(key);
+        if (at == chunks_.size() || chunks_[at].key != key) {
+            chunks_.insert(chunks_.begin() + at, Chunk{key, Container()});
+        }
+        return chunks_[at].container;
+    }
+
+public:
+    // 1. Default constructor
+    RoaringSet() : size_(0) {}
+
+    // 2. Insert a value
+    bool insert(uint32_t value) {
+        bool inserted = chunk_for_insert(static_cast<uint16_t>(value >> 16)).insert(static_cast<uint16_t>(value));
+        size_ += inserted;
+        return inserted;
+    }
+
+    // 3. Insert every value of first .. last (inclusive) : whole runs, no per value work
+    void insert_range(uint32_t first, uint32_t last) {
+        for (uint64_t chunk_first = first; chunk_first <= last; chunk_first = (chunk_first | 0xFFFF) + 1) {
+            uint32_t chunk_last = static_cast<uint32_t>(std::min<uint64_t>(last, chunk_first | 0xFFFF));
+            Container& container = chunk_for_insert(static_cast<uint16_t>(chunk_first >> 16));
+            size_ -= container.cardinality;
+            if (container.cardinality == 0 || chunk_last - chunk_first == 0xFFFF) { // the range is the whole content : one run
+                container = Container();
+                container.kind = Kind::Runs;
+                container.runs.push_back({static_cast<uint16_t>(chunk_first), static_cast<uint16_t>(chunk_last - chunk_first)});
+                container.cardinality = chunk_last - chunk_first + 1;
+                container.optimize();
+                size_ += container.cardinality;
+                continue;
+            }
+            container.to_bitmap();
+            set_range(container.bitmap.data(), chunk_first & 0xFFFF, chunk_last & 0xFFFF);
+            container.cardinality = 0;
+            for (uint64_t word : container.bitmap) {
+                container.cardinality += __builtin_popcountll(word);
+            }
+            container.optimize();
+            size_ += container.cardinality;
+        }
+    }
+
+    // 4. Remove a value
+    bool erase(uint32_t value) {
+        size_t at = chunk_position(static_cast<uint16_t>(value >> 16));
+        if (at == chunks_.size() || chunks_[at].key != (value >> 16) || !chunks_[at].container.erase(static_cast<uint16_t>(value))) {
+            return false;
+        }
+        if (chunks_[at].container.cardinality == 0) {
+            chunks_.erase(chunks_.begin() + at);
+        }
+        --size_;
+        return true;
+    }
+
+    // 5. Check if a value exists
+    bool contains(uint32_t value) const {
+        size_t at = chunk_position(static_cast<uint16_t>(value >> 16));
+        return at != chunks_.size() && chunks_[at].key == (value >> 16) && chunks_[at].container.contains(static_cast<uint16_t>(value));
+    }
+
+    // 6. Get the number of values , check if the set is empty , clear the set
+    size_t size() const {
+        return size_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+    void clear() {
+        chunks_.clear();
+        size_ = 0;
+    }
+
+    // 7. Convert every chunk to its smallest container (run containers for long consecutive ranges)
+    void optimize() {
+        for (Chunk& chunk : chunks_) {
+            chunk.container.optimize();
+        }
+    }
+
+    // 8. Set algebra in place : union , intersection , difference
+    RoaringSet& operator|=(const RoaringSet& other) {
+        combine_with<BitOp::Or>(other);
+        return *this;
+    }
+    RoaringSet& operator&=(const RoaringSet& other) {
+        combine_with<BitOp::And>(other);
+        return *this;
+    }
+    RoaringSet& operator-=(const RoaringSet& other) {
+        combine_with<BitOp::AndNot>(other);
+        return *this;
+    }
+    friend RoaringSet operator|(RoaringSet a, const RoaringSet& b) {
+        return a |= b;
+    }
+    friend RoaringSet operator&(RoaringSet a, const RoaringSet& b) {
+        return a &= b;
+    }
+    friend RoaringSet operator-(RoaringSet a, const RoaringSet& b) {
+        return a -= b;
+    }
+
+    // 9. Visit every value in ascending order
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        for (const Chunk& chunk : chunks_) {
+            uint32_t high = uint32_t(chunk.key) << 16;
+            chunk.container.for_each([&fn, high](uint16_t low) { fn(high | low); });
+        }
+    }
+
+    // 10. Get the bytes owned by the set
+    size_t memory_bytes() const {
+        size_t bytes = sizeof(*this) + chunks_.capacity() * sizeof(Chunk);
+        for (const Chunk& chunk : chunks_) {
+            bytes += chunk.container.memory_bytes();
+        }
+        return bytes;
+    }
+};
+
+/*
+    Set algebra for the hash sets (UnorderedSet, FlatUnorderedSet) : intersection_of, union_of, difference_of and
+    the in-place intersect_with, unite_with, subtract
+    - the smaller set is walked and probed into the larger one, so the cost follows the smaller size
+    - probes go in batches of kProbeBatch : the whole batch is prefetched first, so the cache misses of a batch
+      overlap instead of being paid one after the other
+    - with threads > 1 and at least kParallelMin elements to probe, the probe loop is split across threads
+      (lookups are read-only) ; the results are applied to the output set on the calling thread
+*/
+constexpr size_t kProbeBatch = 32;
+constexpr size_t kParallelMin = size_t(1) << 16;
+
+// Elements of source, split by whether they are in other : on_probe(element, found), called on the calling thread
+template <typename Set, typename OnProbe>
+void probe_into(const Set& source, const Set& other, size_t threads, OnProbe on_probe) {
+    using T = typename Set::value_type;
+    if (threads <= 1 || source.size() < kParallelMin) {
+        const T* batch[kProbeBatch];
+        size_t batch_size = 0;
+        auto flush = [&] {
+            for (size_t i = 0; i < batch_size; ++i) {
+                other.prefetch(*batch[i]);
+            }
+            for (size_t i = 0; i < batch_size; ++i) {
+                on_probe(*batch[i], other.contains(*batch[i]));
+            }
+            batch_size = 0;
+        };
+        source.for_each([&](const T& element) {
+            batch[batch_size++] = &element;
+            if (batch_size == kProbeBatch) flush();
+        });
+        flush();
+        return;
+    }
+
+    // Parallel : lookups are read-only, so threads probe disjoint slices and only record the answers
+    std::vector<const T*> elements;
+    elements.reserve(source.size());
+    source.for_each([&elements](const T& element) { elements.push_back(&element); });
+    std::vector<char> found(elements.size());
+    auto probe_range = [&](size_t first, size_t last) {
+        for (size_t batch = first; batch < last; batch += kProbeBatch) {
+            size_t batch_end = std::min(last, batch + kProbeBatch);
+            for (size_t i = batch; i < batch_end; ++i) {
+                other.prefetch(*elements[i]);
+            }
+            for (size_t i = batch; i < batch_end; ++i) {
+                found[i] = other.contains(*elements[i]);
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    size_t slice = (elements.size() + threads - 1) / threads;
+    for (size_t t = 0; t < threads; ++t) {
+        size_t first = std::min(elements.size(), t * slice);
+        size_t last = std::min(elements.size(), first + slice);
+        workers.emplace_back(probe_range, first, last);
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    for (size_t i = 0; i < elements.size(); ++i) {
+        on_probe(*elements[i], found[i] != 0);
+    }
+}
+
+// 1. Elements in both a and b
+template <typename Set>
+Set intersection_of(const Set& a, const Set& b, size_t threads = 1) {
+    const Set& smaller = a.size() <= b.size() ? a : b;
+    const Set& larger = a.size() <= b.size() ? b : a;
+    Set result;
+    probe_into(smaller, larger, threads, [&result](const typename Set::value_type& element, bool found) {
+        if (found) result.insert(element);
+    });
+    return result;
+}
+
+// 2. Elements in a or b : the larger set is copied, only the smaller one is inserted element by element
+template <typename Set>
+Set union_of(const Set& a, const Set& b) {
+    const Set& smaller = a.size() <= b.size() ? a : b;
+    Set result = a.size() <= b.size() ? b : a;
+    smaller.for_each([&result](const typename Set::value_type& element) { result.insert(element); });
+    return result;
+}
+
+// 3. Elements of a that are not in b
+template <typename Set>
+Set difference_of(const Set& a, const Set& b, size_t threads = 1) {
+    if (b.size() < a.size()) { // cheaper to copy a and erase b's elements than to probe every element of a
+        Set result = a;
+        b.for_each([&result](const typename Set::value_type& element) { result.erase(element); });
+        return result;
+    }
+    Set result;
+    probe_into(a, b, threads, [&result](const typename Set::value_type& element, bool found) {
+        if (!found) result.insert(element);
+    });
+    return result;
+}
+
+// 4. In place : a = a & b
+template <typename Set>
+void intersect_with(Set& a, const Set& b, size_t threads = 1) {
+    using T = typename Set::value_type;
+    if (&a == &b) {
+        return;
+    }
+    if (b.size() < a.size()) {
+        a = intersection_of(a, b, threads);
+        return;
+    }
+    std::vector<T> missing; // a's elements cannot be erased while a is being walked
+    probe_into(a, b, threads, [&missing](const T& element, bool found) {
+        if (!found) missing.push_back(element);
+    });
+    for (const T& element : missing) {
+        a.erase(element);
+    }
+}
+
+// 5. In place : a = a | b
+template <typename Set>
+void unite_with(Set& a, const Set& b) {
+    if (&a == &b) { // inserting into a while walking it could rehash under the walk
+        return;
+    }
+    b.for_each([&a](const typename Set::value_type& element) { a.insert(element); });
+}
+
+// 6. In place : a = a - b
+template <typename Set>
+void subtract(Set& a, const Set& b, size_t threads = 1) {
+    using T = typename Set::value_type;
+    if (&a == &b) { // erasing from a while walking it moves elements under the walk
+        a.clear();
+        return;
+    }
+    if (b.size() <= a.size()) {
+        b.for_each([&a](const T& element) { a.erase(element); });
+        return;
+    }
+    std::vector<T> common;
+    probe_into(a, b, threads, [&common](const T& element, bool found) {
+        if (found) common.push_back(element);
+    });
+    for (const T& element : common) {
+        a.erase(element);
+    }
+}
+
+/*
+    Approximate membership filters : answer "definitely absent" or "maybe present" from far less memory than the set
+    - BlockedBloomFilter : all 8 bits of a key live in one 64-byte block (one cache line), so a lookup is one miss ;
+      no deletes, and the false-positive rate climbs once more keys than expected are added
+    - CuckooFilter : a 16-bit fingerprint per key in buckets of 4, each key has two candidate buckets ;
+      supports erase (of keys that were inserted), and reports full instead of degrading
+    - FilteredSet : puts either filter in front of a set so that misses are answered without touching the set
+*/
+
+// std::hash is the identity for integers : fold a 128-bit multiply so that every output bit depends on every input bit
+inline uint64_t fold_multiply(uint64_t hash) {
+    unsigned __int128 product = static_cast<unsigned __int128>(hash) * 0x9E3779B97F4A7C15ull;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+template <typename T, typename Hash = std::hash<T>>
+class BlockedBloomFilter {
+private:
+    static constexpr size_t kBlockBits = 512;
+    // One odd multiplier per word picks the bit of that word (the split block layout of Parquet's Bloom filter)
+    static constexpr uint32_t kSalt[8] = {0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+                                          0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u};
+
+    struct alignas(64) Block {
+        uint64_t words[8];
+    };
+
+    std::vector<Block> blocks_;
+    Hash hasher_;
+
+    // High 32 bits choose the block (multiply-shift instead of a modulo), low 32 bits choose one bit per word
+    size_t block_index(uint64_t hash) const {
+        return static_cast<size_t>(((hash >> 32) * blocks_.size()) >> 32);
+    }
+    static uint64_t bit_of(uint64_t hash, size_t word) {
+        return uint64_t(1) << ((static_cast<uint32_t>(hash) * kSalt[word]) >> 26);
+    }
+
+public:
+    static constexpr bool supports_erase = false;
+
+    // 1. Constructor : sized for expected_elements at bits_per_element (10 bits : about 1% false positives)
+    explicit BlockedBloomFilter(size_t expected_elements, double bits_per_element = 10)
+        : blocks_(std::max<size_t>(1, static_cast<size_t>(expected_elements * bits_per_element / kBlockBits) + 1)) {
+        clear();
+    }
+
+    // 2. Add a key : always succeeds, a Bloom filter never fills up, it only gets less accurate
+    bool insert(const T& key) {
+        uint64_t hash = fold_multiply(hasher_(key));
+        Block& block = blocks_[block_index(hash)];
+        for (size_t word = 0; word < 8; ++word) {
+            block.words[word] |= bit_of(hash, word);
+        }
+        return true;
+    }
+
+    // 3. false : key was never inserted ; true : key was inserted, or is a false positive
+    bool may_contain(const T& key) const {
+        uint64_t hash = fold_multiply(hasher_(key));
+        const Block& block = blocks_[block_index(hash)];
+        uint64_t missing = 0;
+        for (size_t word = 0; word < 8; ++word) { // no early exit : the block is already in cache, branches cost more
+            missing |= bit_of(hash, word) & ~block.words[word];
+        }
+        return missing == 0;
+    }
+
+    // 4. Remove every key
+    void clear() {
+        std::memset(static_cast<void*>(blocks_.data()), 0, blocks_.size() * sizeof(Block));
+    }
+
+    // 5. Bytes of filter storage
+    size_t memory_bytes() const {
+        return blocks_.size() * sizeof(Block);
+    }
+};
+
+template <typename T, typename Hash = std::hash<T>>
+class CuckooFilter {
+private:
+    static constexpr size_t kBucketSize = 4;
+    static constexpr size_t kMaxKicks = 500;
+
+    struct Bucket {
+        uint16_t fingerprints[kBucketSize]; // 0 marks an empty slot
+    };
+
+    std::vector<Bucket> buckets_; // a power of two of them, so the alternate bucket is an xor
+    size_t mask_;
+    size_t size_;
+    bool has_victim_;             // the fingerprint left homeless by the last failed insert, still counted in size_
+    uint16_t victim_fingerprint_;
+    size_t victim_bucket_;
+    uint64_t random_state_;       // picks which slot to kick
+    Hash hasher_;
+
+    static uint16_t fingerprint_of(uint64_t hash) {
+        uint16_t fingerprint = static_cast<uint16_t>(hash >> 48);
+        return fingerprint == 0 ? 1 : fingerprint;
+    }
+    // Both buckets of a key can be found from either one and the fingerprint : alternate(alternate(i)) == i
+    size_t alternate(size_t bucket, uint16_t fingerprint) const {
+        return (bucket ^ (fingerprint * size_t(0x5bd1e995))) & mask_;
+    }
+
+    bool add_to(size_t bucket, uint16_t fingerprint) {
+        for (uint16_t& slot : buckets_[bucket].fingerprints) {
+            if (slot == 0) {
+                slot = fingerprint;
+                return true;
+            }
+        }
+        return false;
+    }
+    bool remove_from(size_t bucket, uint16_t fingerprint) {
+        for (uint16_t& slot : buckets_[bucket].fingerprints) {
+            if (slot == fingerprint) {
+                slot = 0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Both candidate buckets hold fingerprint ? One SSE2 compare covers the 8 slots of the two buckets
+    bool in_buckets(size_t first, size_t second, uint16_t fingerprint) const {
+#if defined(__SSE2__)
+        uint64_t a, b;
+        std::memcpy(&a, &buckets_[first], sizeof(a));
+        std::memcpy(&b, &buckets_[second], sizeof(b));
+        __m128i slots = _mm_set_epi64x(static_cast<long long>(b), static_cast<long long>(a));
+        __m128i equal = _mm_cmpeq_epi16(slots, _mm_set1_epi16(static_cast<short>(fingerprint)));
+        return _mm_movemask_epi8(equal) != 0;
+#else
+        for (size_t i = 0; i < kBucketSize; ++i) {
+            if (buckets_[first].fingerprints[i] == fingerprint || buckets_[second].fingerprints[i] == fingerprint) {
+                return true;
+            }
+        }
+        return false;
+#endif
+    }
+
+public:
+    static constexpr bool supports_erase = true;
+
+    // 1. Constructor : enough buckets to hold expected_elements at 95% load (16 bits per slot : about 0.01% false positives)
+    explicit CuckooFilter(size_t expected_elements)
+        : mask_(0), size_(0), has_victim_(false), victim_fingerprint_(0), victim_bucket_(0), random_state_(0x2545F4914F6CDD1Dull) {
+        size_t wanted = std::max<size_t>(1, static_cast<size_t>(expected_elements / (kBucketSize * 0.95)) + 1);
+        size_t count = 1;
+        while (count < wanted) count <<= 1;
+        buckets_.assign(count, Bucket{});
+        mask_ = count - 1;
+    }
+
+    // 2. Add a key : false when the filter is full (the key is then not added)
+    bool insert(const T& key) {
+        if (has_victim_) {
+            return false;
+        }
+        uint64_t hash = fold_multiply(hasher_(key));
+        uint16_t fingerprint = fingerprint_of(hash);
+        size_t bucket = hash & mask_;
+        if (add_to(bucket, fingerprint) || add_to(bucket = alternate(bucket, fingerprint), fingerprint)) {
+            ++size_;
+            return true;
+        }
+        // Both buckets full : evict a random resident to its other bucket, and so on
+        for (size_t kick = 0; kick < kMaxKicks; ++kick) {
+            random_state_ ^= random_state_ << 13;
+            random_state_ ^= random_state_ >> 7;
+            random_state_ ^= random_state_ << 17;
+            std::swap(fingerprint, buckets_[bucket].fingerprints[random_state_ % kBucketSize]);
+            bucket = alternate(bucket, fingerprint);
+            if (add_to(bucket, fingerprint)) {
+                ++size_;
+                return true;
+            }
+        }
+        // The new key is in, but some other key's fingerprint is now homeless : keep it aside, and refuse further inserts
+        has_victim_ = true;
+        victim_fingerprint_ = fingerprint;
+        victim_bucket_ = bucket;
+        ++size_;
+        return true;
+    }
+
+    // 3. false : key was never inserted (or was erased) ; true : key is present, or is a false positive
+    bool may_contain(const T& key) const {
+        uint64_t hash = fold_multiply(hasher_(key));
+        uint16_t fingerprint = fingerprint_of(hash);
+        size_t bucket = hash & mask_;
+        size_t other = alternate(bucket, fingerprint);
+        if (has_victim_ && victim_fingerprint_ == fingerprint && (victim_bucket_ == bucket || victim_bucket_ == other)) {
+            return true;
+        }
+        return in_buckets(bucket, other, fingerprint);
+    }
+
+    // 4. Remove a key : only for keys that were inserted, erasing anything else can remove another key's fingerprint
+    bool erase(const T& key) {
+        uint64_t hash = fold_multiply(hasher_(key));
+        uint16_t fingerprint = fingerprint_of(hash);
+        size_t bucket = hash & mask_;
+        size_t other = alternate(bucket, fingerprint);
+        if (remove_from(bucket, fingerprint) || remove_from(other, fingerprint)) {
+            --size_;
+            if (has_victim_ && (add_to(victim_bucket_, victim_fingerprint_) ||
+                                add_to(alternate(victim_bucket_, victim_fingerprint_), victim_fingerprint_))) {
+                has_victim_ = false; // a slot opened up next to the victim
+            }
+            return true;
+        }
+        if (has_victim_ && victim_fingerprint_ == fingerprint && (victim_bucket_ == bucket || victim_bucket_ == other)) {
+            has_victim_ = false;
+            --size_;
+            return true;
+        }
+        return false;
     }
-    // this returns an iterator to the key value pair in the bucket
-    auto find_in_bucket(const T& key, size_t bucket_index) {
-        auto& bucket = (*buckets)[bucket_index];
-        return std::find(bucket.begin(), bucket.end(), key);
+
+    // 5. Number of keys held
+    size_t size() const {
+        return size_;
     }
 
-    // Resize the hash table
-    void rehash(size_t new_bucket_count) {
-        auto new_buckets = new std::vector<std::list<T>>(new_bucket_count);
-        for (const auto& bucket : *buckets) {
-            for (const auto& element : bucket) {
-                size_t new_index = std::hash<T>{}(element) % new_bucket_count;
-                (*new_buckets)[new_index].push_back(element);
+    // 6. Number of fingerprint slots, and the fraction in use
+    size_t capacity() const {
+        return buckets_.size() * kBucketSize;
+    }
+    double load_factor() const {
+        return static_cast<double>(size_) / capacity();
+    }
+
+    // 7. Remove every key
+    void clear() {
+        std::fill(buckets_.begin(), buckets_.end(), Bucket{});
+        size_ = 0;
+        has_victim_ = false;
+    }
+
+    // 8. Bytes of filter storage
+    size_t memory_bytes() const {
+        return buckets_.size() * sizeof(Bucket);
+    }
+};
+
+/*
+    FilteredSet : a set with a filter in front, for workloads where most lookups are misses
+    - contains asks the filter first ; only "maybe present" reaches the set, so a miss costs one small filter probe
+      instead of a walk through a table much larger than cache
+    - the filter is rebuilt from the set, at twice the capacity, once the set outgrows it (or a cuckoo filter is full)
+    - erase goes to the filter when it supports deletes ; otherwise the stale Bloom bits only raise the false-positive
+      rate, and the filter is rebuilt once stale keys reach half its capacity
+*/
+template <typename Set, typename Filter>
+class FilteredSet {
+public:
+    using value_type = typename Set::value_type;
+
+private:
+    Set set_;
+    Filter filter_;
+    size_t filter_capacity_; // keys the filter was sized for
+    size_t stale_;           // keys erased from the set but still in a Bloom filter
+
+    void rebuild(size_t capacity) {
+        for (;;) {
+            Filter filter(capacity);
+            bool full = false;
+            set_.for_each([&](const value_type& key) { full = !filter.insert(key) || full; });
+            if (!full) {
+                filter_ = std::move(filter);
+                filter_capacity_ = capacity;
+                stale_ = 0;
+                return;
             }
+            capacity *= 2;
         }
-        delete buckets;
-        buckets = new_buckets;
-        bucket_count_ = new_bucket_count;
     }
 
 public:
-    // 1. Default constructor
-    UnorderedSet() : size_(0), bucket_count_(10), max_load_factor_(1.0) {
-        buckets = new std::vector<std::list<T>>(bucket_count_);
+    // 1. Constructor : the filter is first sized for expected_elements
+    explicit FilteredSet(size_t expected_elements = 1024)
+        : filter_(std::max<size_t>(1, expected_elements)), filter_capacity_(std::max<size_t>(1, expected_elements)), stale_(0) {}
+
+    // 2. Insert an element
+    bool insert(const value_type& key) {
+        if (!set_.insert(key)) {
+            return false;
+        }
+        if (set_.size() > filter_capacity_ || !filter_.insert(key)) {
+            rebuild(std::max(filter_capacity_ * 2, set_.size()));
+        }
+        return true;
     }
 
-    // 2. Constructor with initial bucket count
-    explicit UnorderedSet(size_t bucket_count) : size_(0), bucket_count_(bucket_count), max_load_factor_(1.0) {
-        buckets = new std::vector<std::list<T>>(bucket_count_);
+    // 3. Remove an element
+    bool erase(const value_type& key) {
+        if (!set_.erase(key)) {
+            return false;
+        }
+        if constexpr (Filter::supports_erase) {
+            filter_.erase(key);
+        } else if (++stale_ > filter_capacity_ / 2) {
+            rebuild(filter_capacity_);
+        }
+        return true;
     }
 
-    // 3. Insert an element
+    // 4. Check if an element exists : the set is only consulted when the filter says maybe
+    bool contains(const value_type& key) const {
+        return filter_.may_contain(key) && set_.contains(key);
+    }
+
+    // 5. Visit every element
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        set_.for_each(fn);
+    }
+
+    // 6. Get the number of elements, check if empty
+    size_t size() const {
+        return set_.size();
+    }
+    bool empty() const {
+        return set_.empty();
+    }
+
+    // 7. Clear the set and the filter
+    void clear() {
+        set_.clear();
+        filter_.clear();
+        stale_ = 0;
+    }
+
+    // 8. The underlying set and filter, read-only
+    const Set& set() const {
+        return set_;
+    }
+    const Filter& filter() const {
+        return filter_;
+    }
+};
+
+/*
+    ConcurrentInsertSet : insert-only set shared by many threads, for deduplication (insert returns whether it was new)
+    - open addressing with linear probing over a slot array of atomic node pointers ; an insert claims an empty slot
+      with one compare-and-swap, so threads never take a lock, and two threads racing on the same key contend for
+      the same first empty slot : one wins, the other sees the winner's node and returns false
+    - elements are never removed, so a full slot stays full : lookups are plain loads
+    - user-space pointers use 48 bits, so the top 16 bits of a slot carry 16 bits of the key's hash : a probe only
+      follows the pointer when that tag matches, instead of taking a cache miss on every occupied slot it passes
+    - past 3/4 load a table twice the size is linked as next, and every thread that touches the old table helps move
+      it : chunks of kMigrateChunk slots are claimed with fetch_add, each node is copied to the new table before its
+      old slot is marked kMoved, so a lookup that skips kMoved slots and then searches next never misses
+    - inserts wait until the whole old table has moved before using the new one (a key still in the old table must
+      not be inserted again) : the only point where a thread waits on others
+    - old tables stay allocated until the set is destroyed, since a reader may still be walking them
+    - nodes are carved from blocks of doubling size with one fetch_add (no malloc per element) ; a node made for a
+      key that another thread inserted first stays unused in its block
+*/
+template <typename T, typename Hash = std::hash<T>, typename KeyEqual = std::equal_to<T>>
+class ConcurrentInsertSet {
+public:
+    using value_type = T;
+
+private:
+    static constexpr size_t kMigrateChunk = 1024;
+    static constexpr size_t kFirstBlockNodes = 1024; // block b holds kFirstBlockNodes << b nodes
+    static constexpr size_t kMaxBlocks = 40;
+
+    struct Node {
+        uint64_t hash;
+        T key;
+    };
+
+    // A slot holds 0 (empty), kMoved (node copied to the next table), or a node pointer with its hash tag on top
+    using Slot = uint64_t;
+    static constexpr Slot kEmptySlot = 0;
+    static constexpr Slot kMoved = 1;
+    static constexpr int kTagShift = 48;
+    static_assert(sizeof(void*) == 8, "ConcurrentInsertSet tags the top 16 bits of 64-bit pointers");
+
+    struct Table {
+        size_t capacity; // a power of two
+        std::unique_ptr<std::atomic<Slot>[]> slots;
+        std::atomic<size_t> count{0};
+        std::atomic<Table*> next{nullptr};
+        std::atomic<size_t> claimed{0};  // first slot not yet handed to a migrating thread
+        std::atomic<size_t> migrated{0}; // slots already moved to next
+        Table* previous;                 // the table this one replaced, freed with the set
+
+        Table(size_t slot_count, Table* replaced) : capacity(slot_count), slots(new std::atomic<Slot>[slot_count]), previous(replaced) {
+            for (size_t i = 0; i < capacity; ++i) {
+                slots[i].store(kEmptySlot, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    enum class Probe { Inserted, Present, Resizing };
+
+    static Slot pack(Node* node) {
+        return reinterpret_cast<uintptr_t>(node) | (node->hash >> kTagShift << kTagShift);
+    }
+    static Node* node_of(Slot slot) {
+        return reinterpret_cast<Node*>(slot & ((uint64_t(1) << kTagShift) - 1));
+    }
+    static bool tag_matches(Slot slot, uint64_t hash) {
+        return (slot >> kTagShift) == (hash >> kTagShift);
+    }
+
+    std::atomic<Table*> root_;
+    std::atomic<Node*> blocks_[kMaxBlocks];
+    std::atomic<size_t> nodes_used_;
+    Hash hasher_;
+    KeyEqual key_eq_;
+
+    // Node number i lives in block b = log2(i / kFirstBlockNodes + 1) ; the first thread to reach a block allocates it
+    Node* node_at(size_t index, bool allocate) {
+        size_t block = 63 - __builtin_clzll(index / kFirstBlockNodes + 1);
+        size_t offset = index - kFirstBlockNodes * ((size_t(1) << block) - 1);
+        Node* nodes = blocks_[block].load(std::memory_order_acquire);
+        if (nodes == nullptr && allocate) {
+            Node* fresh = static_cast<Node*>(::operator new(sizeof(Node) * (kFirstBlockNodes << block)));
+            if (blocks_[block].compare_exchange_strong(nodes, fresh, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                nodes = fresh;
+            } else {
+                ::operator delete(fresh);
+            }
+        }
+        return nodes + offset;
+    }
+
+    Node* make_node(uint64_t hash, const T& key) {
+        return new (node_at(nodes_used_.fetch_add(1, std::memory_order_relaxed), true)) Node{hash, key};
+    }
+
+    Probe try_insert(Table* table, uint64_t hash, const T& key, Node*& node) {
+        size_t mask = table->capacity - 1;
+        for (size_t i = hash & mask, probes = 0; probes < table->capacity; i = (i + 1) & mask, ++probes) {
+            Slot current = table->slots[i].load(std::memory_order_acquire);
+            if (current == kEmptySlot) {
+                if (node == nullptr) {
+                    node = make_node(hash, key);
+                }
+                if (table->slots[i].compare_exchange_strong(current, pack(node), std::memory_order_acq_rel, std::memory_order_acquire)) {
+                    return Probe::Inserted;
+                }
+                // Lost the slot : current now holds what won it
+            }
+            if (current == kMoved) {
+                return Probe::Resizing;
+            }
+            if (tag_matches(current, hash) && node_of(current)->hash == hash && key_eq_(node_of(current)->key, key)) {
+                return Probe::Present;
+            }
+        }
+        return Probe::Resizing; // every slot full : only reachable when many threads overshoot the 3/4 trigger together
+    }
+
+    // Copy of a node from the old table : keys are already unique, so take the first empty slot
+    static void insert_moved(Table* table, Slot slot) {
+        size_t mask = table->capacity - 1;
+        for (size_t i = node_of(slot)->hash & mask;; i = (i + 1) & mask) {
+            Slot expected = kEmptySlot;
+            if (table->slots[i].compare_exchange_strong(expected, slot, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                table->count.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+
+    // Link a table twice the size after table, unless another thread already did
+    void start_resize(Table* table) {
+        if (table->next.load(std::memory_order_acquire) == nullptr) {
+            Table* bigger = new Table(table->capacity * 2, table);
+            Table* expected = nullptr;
+            if (!table->next.compare_exchange_strong(expected, bigger, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                delete bigger;
+            }
+        }
+    }
+
+    // Move chunks of table until none are left unclaimed, wait for the other movers, then return the new table
+    Table* help_resize(Table* table) {
+        start_resize(table);
+        Table* next = table->next.load(std::memory_order_acquire);
+        for (;;) {
+            size_t first = table->claimed.fetch_add(kMigrateChunk, std::memory_order_relaxed);
+            if (first >= table->capacity) {
+                break;
+            }
+            size_t last = std::min(table->capacity, first + kMigrateChunk);
+            for (size_t i = first; i < last; ++i) {
+                for (;;) {
+                    Slot current = table->slots[i].load(std::memory_order_acquire);
+                    if (current == kEmptySlot) {
+                        if (table->slots[i].compare_exchange_strong(current, kMoved, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                            break;
+                        }
+                        continue; // an insert filled the slot first : move its node
+                    }
+                    insert_moved(next, current); // copy first, then mark : a reader never finds the key in neither table
+                    table->slots[i].store(kMoved, std::memory_order_release);
+                    break;
+                }
+            }
+            table->migrated.fetch_add(last - first, std::memory_order_acq_rel);
+        }
+        while (table->migrated.load(std::memory_order_acquire) < table->capacity) {
+            std::this_thread::yield();
+        }
+        Table* expected = table;
+        root_.compare_exchange_strong(expected, next, std::memory_order_acq_rel, std::memory_order_acquire);
+        return next;
+    }
+
+public:
+    // 1. Constructor : initial_capacity slots, rounded up to a power of two
+    explicit ConcurrentInsertSet(size_t initial_capacity = 1024) : nodes_used_(0) {
+        for (std::atomic<Node*>& block : blocks_) {
+            block.store(nullptr, std::memory_order_relaxed);
+        }
+        size_t capacity = 16;
+        while (capacity < initial_capacity) capacity <<= 1;
+        root_.store(new Table(capacity, nullptr), std::memory_order_relaxed);
+    }
+
+    ConcurrentInsertSet(const ConcurrentInsertSet&) = delete;
+    ConcurrentInsertSet& operator=(const ConcurrentInsertSet&) = delete;
+
+    // 2. Insert an element : true if it was not there yet ; safe from any number of threads
     bool insert(const T& key) {
-        size_t index = hash(key);
-        auto it = find_in_bucket(key, index);
-        if (it == (*buckets)[index].end()) {
-            (*buckets)[index].push_back(key);
-            ++size_;
-            if (size_ > bucket_count_ * max_load_factor_) {
-                rehash(bucket_count_ * 2);
+        uint64_t hash = fold_multiply(hasher_(key));
+        Node* node = nullptr; // made on the first empty slot, reused if that CAS is lost to another key
+        Table* table = root_.load(std::memory_order_acquire);
+        for (;;) {
+            switch (try_insert(table, hash, key, node)) {
+            case Probe::Inserted:
+                if (table->count.fetch_add(1, std::memory_order_relaxed) + 1 > table->capacity / 4 * 3) {
+                    help_resize(table);
+                }
+                return true;
+            case Probe::Present:
+                return false;
+            case Probe::Resizing:
+                table = help_resize(table);
+                break;
             }
-            return true;
         }
-        return false;
     }
 
-    // 4. Remove an element
-    bool erase(const T& key) {
-        size_t index = hash(key);
-        auto it = find_in_bucket(key, index);
-        if (it != (*buckets)[index].end()) {
-            (*buckets)[index].erase(it);
-            --size_;
-            return true;
+    // 3. Check if an element exists : lock-free, safe during inserts and resizes
+    bool contains(const T& key) const {
+        uint64_t hash = fold_multiply(hasher_(key));
+        for (Table* table = root_.load(std::memory_order_acquire); table != nullptr; table = table->next.load(std::memory_order_acquire)) {
+            size_t mask = table->capacity - 1;
+            for (size_t i = hash & mask, probes = 0; probes < table->capacity; i = (i + 1) & mask, ++probes) {
+                Slot current = table->slots[i].load(std::memory_order_acquire);
+                if (current == kEmptySlot) {
+                    break;
+                }
+                if (current != kMoved && tag_matches(current, hash) && node_of(current)->hash == hash && key_eq_(node_of(current)->key, key)) {
+                    return true;
+                }
+            }
         }
         return false;
     }
 
-    // 5. Check if an element exists
-    bool contains(const T& key)  { // here we call the const version of find_in_bucket since we are not modifying the set
-        size_t index = hash(key);
-        auto it = find_in_bucket(key, index);
-        return it != (*buckets)[index].end();
+    // 4. Get the number of elements : exact once inserts have stopped
+    size_t size() const {
+        return root_.load(std::memory_order_acquire)->count.load(std::memory_order_relaxed);
     }
 
-    // 6. Get the number of elements
+    // 5. Number of slots of the current table
+    size_t capacity() const {
+        return root_.load(std::memory_order_acquire)->capacity;
+    }
+
+    // 6. Visit every element : only once inserts have stopped
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        Table* table = root_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < table->capacity; ++i) {
+            Slot current = table->slots[i].load(std::memory_order_acquire);
+            if (current != kEmptySlot && current != kMoved) {
+                fn(node_of(current)->key);
+            }
+        }
+    }
+
+    // Destructor : destroys every node made (used or not), frees the node blocks and every table
+    ~ConcurrentInsertSet() {
+        size_t used = nodes_used_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < used; ++i) {
+            node_at(i, false)->~Node();
+        }
+        for (std::atomic<Node*>& block : blocks_) {
+            ::operator delete(block.load(std::memory_order_relaxed));
+        }
+        Table* table = root_.load(std::memory_order_acquire);
+        while (Table* next = table->next.load(std::memory_order_acquire)) {
+            table = next;
+        }
+        while (table != nullptr) {
+            Table* previous = table->previous;
+            delete table;
+            table = previous;
+        }
+    }
+};
+
+/*
+    HyperLogLog : estimates the number of distinct elements in a few KB, whatever the stream size (HyperLogLog++ layout)
+    - the 64-bit hash of an element picks a register with its top p bits ; the register keeps the longest run of
+      leading zeros (+1) seen in the remaining bits : with n distinct elements each register sees about n / m hashes,
+      and the longest run grows like log2(n / m)
+    - sparse while few registers are touched : a sorted list of (25-bit index, run) entries, i.e. a precision 2^25
+      sketch counted exactly by linear counting ; new entries go to a small unsorted buffer merged in batches
+    - dense once the list would outgrow the registers : one byte per register, 2^p bytes (16 KB at p = 14)
+    - estimate : the HyperLogLog++ paper corrects the raw estimate with empirical bias tables ; this uses Ertl's
+      improved estimator instead, which is unbiased over the whole range from the register histogram alone
+    - merge keeps the larger of each register pair (SSE2 max of 16 registers at a time), so sketches built by
+      separate threads combine into the sketch of the whole stream
+    - standard error 1.04 / sqrt(2^p) : 0.8% at p = 14
+*/
+template <typename T, typename Hash = std::hash<T>>
+class HyperLogLog {
+public:
+    using value_type = T;
+
+private:
+    static constexpr int kSparsePrecision = 25;
+    static constexpr size_t kBufferSize = 256;
+
+    int precision_;
+    std::vector<uint8_t> registers_; // dense : 2^precision_ registers, empty while sparse
+    std::vector<uint32_t> sparse_;   // sorted, one entry per touched 25-bit index : index << 6 | run
+    std::vector<uint32_t> buffer_;   // sparse entries not yet merged into sparse_
+    Hash hasher_;
+
+    // The estimate reads the hash bit by bit, so every bit must be independent : a table's fold_multiply leaves
+    // patterns in the top bits for sequential keys ; the splitmix64 finalizer does not
+    uint64_t hash_of(const T& key) const {
+        uint64_t z = hasher_(key);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Leading zeros of the top `bits` bits of word, + 1 (bits + 1 when they are all zero)
+    static uint8_t run_length(uint64_t word, int bits) {
+        uint64_t marked = word | (uint64_t(1) << (63 - bits)); // stop bit just past the bits that count
+        return static_cast<uint8_t>(__builtin_clzll(marked) + 1);
+    }
+
+    // A sparse entry at precision 25 becomes register index >> (25 - p) at precision p
+    void apply_to_registers(uint32_t entry) {
+        uint32_t index = entry >> 6;
+        int extra_bits = kSparsePrecision - precision_;
+        uint32_t low = index & ((uint32_t(1) << extra_bits) - 1);
+        uint8_t run = low != 0 ? static_cast<uint8_t>(__builtin_clz(low) - (32 - extra_bits) + 1)
+                               : static_cast<uint8_t>(extra_bits + (entry & 63));
+        uint8_t& reg = registers_[index >> extra_bits];
+        reg = std::max(reg, run);
+    }
+
+    // Fold buffer_ into sparse_ : sorted by index, the longest run kept per index
+    void flush_buffer() {
+        if (buffer_.empty()) {
+            return;
+        }
+        std::sort(buffer_.begin(), buffer_.end());
+        std::vector<uint32_t> merged;
+        merged.reserve(sparse_.size() + buffer_.size());
+        std::merge(sparse_.begin(), sparse_.end(), buffer_.begin(), buffer_.end(), std::back_inserter(merged));
+        size_t out = 0;
+        for (uint32_t entry : merged) { // equal indices are adjacent, in increasing run order : the last one wins
+            if (out != 0 && (merged[out - 1] >> 6) == (entry >> 6)) {
+                merged[out - 1] = entry;
+            } else {
+                merged[out++] = entry;
+            }
+        }
+        merged.resize(out);
+        sparse_.swap(merged);
+        buffer_.clear();
+        if (sparse_.size() * sizeof(uint32_t) >= (size_t(1) << precision_)) {
+            to_dense();
+        }
+    }
+
+    void to_dense() {
+        registers_.assign(size_t(1) << precision_, 0);
+        for (uint32_t entry : sparse_) apply_to_registers(entry);
+        for (uint32_t entry : buffer_) apply_to_registers(entry);
+        std::vector<uint32_t>().swap(sparse_);
+        std::vector<uint32_t>().swap(buffer_);
+    }
+
+    // Ertl, "New cardinality estimation algorithms for HyperLogLog sketches" (2017), algorithm 6
+    static double sigma(double x) {
+        if (x == 1) return INFINITY;
+        double y = 1, z = x;
+        for (;;) {
+            x *= x;
+            double previous = z;
+            z += x * y;
+            y += y;
+            if (z == previous) return z;
+        }
+    }
+    static double tau(double x) {
+        if (x == 0 || x == 1) return 0;
+        double y = 1, z = 1 - x;
+        for (;;) {
+            x = std::sqrt(x);
+            double previous = z;
+            y *= 0.5;
+            z -= (1 - x) * (1 - x) * y;
+            if (z == previous) return z / 3;
+        }
+    }
+
+public:
+    // 1. Constructor : 2^precision registers once dense, precision in [4, 18]
+    explicit HyperLogLog(int precision = 14) : precision_(precision) {
+        if (precision < 4 || precision > 18) {
+            throw std::invalid_argument("HyperLogLog precision must be in [4, 18]");
+        }
+        buffer_.reserve(kBufferSize);
+    }
+
+    // 2. Add an element
+    void insert(const T& key) {
+        uint64_t hash = hash_of(key);
+        if (!registers_.empty()) {
+            uint8_t& reg = registers_[hash >> (64 - precision_)];
+            reg = std::max(reg, run_length(hash << precision_, 64 - precision_));
+            return;
+        }
+        buffer_.push_back(static_cast<uint32_t>(hash >> (64 - kSparsePrecision)) << 6 |
+                          run_length(hash << kSparsePrecision, 64 - kSparsePrecision));
+        if (buffer_.size() == kBufferSize) {
+            flush_buffer();
+        }
+    }
+
+    // 3. Estimated number of distinct elements inserted
+    double estimate() const {
+        if (registers_.empty()) { // linear counting over the 2^25 sparse registers : exact up to hash collisions
+            std::vector<uint32_t> indices;
+            indices.reserve(sparse_.size() + buffer_.size());
+            for (uint32_t entry : sparse_) indices.push_back(entry >> 6);
+            for (uint32_t entry : buffer_) indices.push_back(entry >> 6);
+            std::sort(indices.begin(), indices.end());
+            double touched = static_cast<double>(std::unique(indices.begin(), indices.end()) - indices.begin());
+            double slots = static_cast<double>(uint64_t(1) << kSparsePrecision);
+            return slots * std::log(slots / (slots - touched));
+        }
+        int q = 64 - precision_;
+        std::vector<double> histogram(q + 2, 0.0); // histogram[k] : registers holding k
+        for (uint8_t reg : registers_) histogram[reg] += 1;
+        double m = static_cast<double>(registers_.size());
+        double z = m * tau(1 - histogram[q + 1] / m);
+        for (int k = q; k >= 1; --k) {
+            z = 0.5 * (z + histogram[k]);
+        }
+        z += m * sigma(histogram[0] / m);
+        return m * m / (2 * std::log(2.0) * z);
+    }
+
+    // 4. Estimate rounded, for code that used UnorderedSet::size() to count distinct values
     size_t size() const {
-        return size_;
+        return static_cast<size_t>(std::llround(estimate()));
     }
 
-    // 7. Check if the set is empty
-    bool empty() const {
-        return size_ == 0;
+    // 5. Fold another sketch of the same precision into this one : the sketch of both streams together
+    void merge(const HyperLogLog& other) {
+        if (other.precision_ != precision_) {
+            throw std::invalid_argument("HyperLogLog::merge needs sketches of the same precision");
+        }
+        if (&other == this) {
+            return;
+        }
+        if (registers_.empty() && other.registers_.empty()) {
+            buffer_.insert(buffer_.end(), other.sparse_.begin(), other.sparse_.end());
+            buffer_.insert(buffer_.end(), other.buffer_.begin(), other.buffer_.end());
+            flush_buffer();
+            return;
+        }
+        if (registers_.empty()) {
+            to_dense();
+        }
+        if (other.registers_.empty()) {
+            for (uint32_t entry : other.sparse_) apply_to_registers(entry);
+            for (uint32_t entry : other.buffer_) apply_to_registers(entry);
+            return;
+        }
+        size_t i = 0;
+#if defined(__SSE2__)
+        for (; i + 16 <= registers_.size(); i += 16) {
+            __m128i mine = _mm_loadu_si128(reinterpret_cast<const __m128i*>(registers_.data() + i));
+            __m128i theirs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(other.registers_.data() + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(registers_.data() + i), _mm_max_epu8(mine, theirs));
+        }
+#endif
+        for (; i < registers_.size(); ++i) {
+            registers_[i] = std::max(registers_[i], other.registers_[i]);
+        }
     }
 
-    // 8. Clear the set
+    // 6. Forget every element
     void clear() {
-        for (auto& bucket : *buckets) {
-            bucket.clear();
+        std::vector<uint8_t>().swap(registers_);
+        sparse_.clear();
+        buffer_.clear();
+    }
+
+    // 7. Representation and size
+    bool is_sparse() const {
+        return registers_.empty();
+    }
+    int precision() const {
+        return precision_;
+    }
+    double standard_error() const {
+        return 1.04 / std::sqrt(static_cast<double>(uint64_t(1) << precision_));
+    }
+    size_t memory_bytes() const {
+        return registers_.capacity() + (sparse_.capacity() + buffer_.capacity()) * sizeof(uint32_t);
+    }
+};
+
+// Heap bytes currently allocated by the process (glibc), 0 where it cannot be measured
+size_t heap_bytes_in_use() {
+#if defined(__GLIBC__)
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd; // small chunks + mmapped large blocks
+#else
+    return 0;
+#endif
+}
+
+// contains for the benchmarks : std::unordered_set only has count before C++20
+template <typename Set, typename T>
+bool set_contains(Set& set, const T& key) {
+    return set.contains(key);
+}
+template <typename T>
+bool set_contains(std::unordered_set<T>& set, const T& key) {
+    return set.count(key) != 0;
+}
+
+// Wall-clock milliseconds taken by body(), shared by the benchmarks below
+template <typename Body>
+double time_ms(Body&& body) {
+    auto start = chrono::steady_clock::now();
+    body();
+    return chrono::duration<double, std::milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Benchmark : heap footprint and insert / lookup / erase throughput of one set type on count integers
+template <typename Set>
+void benchmark_set(const char* name, size_t count) {
+    std::vector<uint64_t> keys(count);
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for (uint64_t& key : keys) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        key = state;
+    }
+    size_t heap_before = heap_bytes_in_use();
+    Set* set = nullptr;
+    double insert_ms = time_ms([&] {
+        set = new Set();
+        for (uint64_t key : keys) {
+            set->insert(key);
+        }
+    });
+    size_t heap_bytes = heap_bytes_in_use() - heap_before;
+    size_t hits = 0;
+    double lookup_ms = time_ms([&] {
+        for (uint64_t key : keys) {
+            hits += set_contains(*set, key);      // hit
+            hits += set_contains(*set, key + 1);  // miss (almost surely)
+        }
+    });
+    double erase_ms = time_ms([&] {
+        for (size_t i = 0; i < count; i += 2) {
+            set->erase(keys[i]);
+        }
+    });
+    delete set;
+    cout << "  " << name << " : " << heap_bytes / static_cast<double>(count) << " bytes/element, insert " << count / insert_ms / 1e3
+         << " Mops/s, contains " << 2 * count / lookup_ms / 1e3 << " Mops/s, erase " << count / 2 / erase_ms / 1e3 << " Mops/s (" << hits
+         << " hits)" << endl;
+}
+
+void benchmark_sets(size_t count) {
+    cout << count << " uint64_t :" << endl;
+    benchmark_set<UnorderedSet<uint64_t>>("UnorderedSet      ", count);
+    benchmark_set<std::unordered_set<uint64_t>>("std::unordered_set", count);
+    benchmark_set<FlatUnorderedSet<uint64_t>>("FlatUnorderedSet  ", count);
+}
+
+// Check : RoaringSet keeps its values when a range lands in a chunk of each container kind ; throws on a mismatch
+void check_roaring() {
+    for (int kind = 0; kind < 3; ++kind) { // array , bitmap , runs
+        RoaringSet set;
+        std::vector<uint32_t> expected;
+        if (kind == 2) {
+            set.insert_range(0, 9998);
+            for (uint32_t value = 0; value <= 9998; ++value) expected.push_back(value);
+        } else {
+            for (uint32_t value = 0; value < (kind == 0 ? 1000u : 10000u); value += 2) {
+                set.insert(value);
+                expected.push_back(value);
+            }
+        }
+        set.insert_range(20001, 20002);
+        expected.push_back(20001);
+        expected.push_back(20002);
+        std::vector<uint32_t> actual;
+        set.for_each([&actual](uint32_t value) { actual.push_back(value); });
+        if (actual != expected || set.size() != expected.size() || !set.contains(0)) {
+            throw std::logic_error("RoaringSet::insert_range lost values of an existing chunk");
+        }
+        RoaringSet& same = set; // algebra with itself as the right operand
+        set |= same;
+        set &= same;
+        if (set.size() != expected.size() || !set.contains(20002)) {
+            throw std::logic_error("RoaringSet: a |= a or a &= a changed a");
+        }
+        set -= same;
+        if (!set.empty() || set.contains(0)) {
+            throw std::logic_error("RoaringSet: a -= a is not empty");
         }
-        size_ = 0;
     }
+}
 
-    // 9. Get the number of buckets
-    size_t bucket_count() const {
-        return bucket_count_;
+// Benchmark : memory of dense and sparse ID sets, and RoaringSet algebra against probing a hash set
+void benchmark_roaring() {
+    const uint32_t count = 1 << 20;
+    auto heap_of = [](auto build) {
+        size_t before = heap_bytes_in_use();
+        auto* set = build();
+        size_t bytes = heap_bytes_in_use() - before;
+        delete set;
+        return bytes;
+    };
+    for (bool dense : {true, false}) {
+        std::vector<uint32_t> ids(count);
+        uint32_t state = 2463534242u;
+        for (uint32_t i = 0; i < count; ++i) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            ids[i] = dense ? i : state;
+        }
+        size_t list_bytes = heap_of([&] {
+            auto* set = new UnorderedSet<uint32_t>();
+            for (uint32_t id : ids) set->insert(id);
+            return set;
+        });
+        size_t flat_bytes = heap_of([&] {
+            auto* set = new FlatUnorderedSet<uint32_t>();
+            for (uint32_t id : ids) set->insert(id);
+            return set;
+        });
+        size_t roaring_bytes = heap_of([&] {
+            auto* set = new RoaringSet();
+            for (uint32_t id : ids) set->insert(id);
+            set->optimize();
+            return set;
+        });
+        cout << "1M " << (dense ? "dense" : "random") << " ids : UnorderedSet " << list_bytes / 1024 << " KB, FlatUnorderedSet " << flat_bytes / 1024
+             << " KB, RoaringSet " << roaring_bytes / 1024 << " KB" << endl;
     }
 
-    // 10. Get the current load factor
-    float load_factor() const {
-        return static_cast<float>(size_) / bucket_count_;
+    // Two half-full sets over the same 4M ids : every chunk is a bitmap
+    RoaringSet a, b;
+    std::unordered_set<uint32_t> hash_a, hash_b;
+    uint32_t state = 88675123u;
+    for (uint32_t id = 0; id < 4 * count; ++id) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        if (state & 1) { a.insert(id); hash_a.insert(id); }
+        if (state & 2) { b.insert(id); hash_b.insert(id); }
     }
+    size_t sizes = 0;
+    double union_ms = time_ms([&] { sizes += (a | b).size(); });
+    double intersection_ms = time_ms([&] { sizes += (a & b).size(); });
+    double difference_ms = time_ms([&] { sizes += (a - b).size(); });
+    double probe_ms = time_ms([&] {
+        size_t common = 0;
+        for (uint32_t id : hash_a) {
+            common += hash_b.count(id);
+        }
+        sizes += common;
+    });
+    cout << "2M x 2M ids : RoaringSet union " << union_ms << " ms, intersection " << intersection_ms << " ms, difference " << difference_ms
+         << " ms ; std::unordered_set intersection by probing " << probe_ms << " ms (" << sizes << ")" << endl;
+}
 
-    // 11. Set the maximum load factor
-    void max_load_factor(float mlf) {
-        max_load_factor_ = mlf;
-        if (load_factor() > max_load_factor_) {
-            rehash(size_ / max_load_factor_ + 1);
+// Benchmark : intersection_of against walking one set and calling contains on the other, for a large and a small operand
+template <typename Set>
+void benchmark_set_algebra(const char* name, size_t large_count, size_t small_count) {
+    Set large, small;
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < large_count; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        large.insert(state);
+        if (i % 2 == 0 && small.size() < small_count) small.insert(state); // half of small is shared with large
+        if (i % 2 == 1 && small.size() < small_count) small.insert(~state);
+    }
+    size_t sizes = 0;
+    double naive_ms = time_ms([&] { // the obvious loop : walk the left operand, probe the right one
+        Set result;
+        large.for_each([&](uint64_t element) {
+            if (small.contains(element)) result.insert(element);
+        });
+        sizes += result.size();
+    });
+    double batched_ms = time_ms([&] { sizes += intersection_of(large, small).size(); });
+    double threaded_ms = time_ms([&] { sizes += intersection_of(large, small, 4).size(); });
+    double unite_ms = time_ms([&] {
+        Set copy = large;
+        unite_with(copy, small);
+        sizes += copy.size();
+    });
+    cout << name << " " << large_count << " & " << small_count << " : walk left and probe " << naive_ms << " ms, intersection_of " << batched_ms
+         << " ms, 4 threads " << threaded_ms << " ms ; copy + unite_with " << unite_ms << " ms (" << sizes << ")" << endl;
+}
+
+// Benchmark : false-positive rate, size and probe speed of the filters, then misses against a set with and without one
+void benchmark_filters() {
+    const size_t count = 1 << 20;
+    auto random_keys = [](size_t n, uint64_t state) {
+        std::vector<uint64_t> keys(n);
+        for (uint64_t& key : keys) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            key = state;
         }
+        return keys;
+    };
+    std::vector<uint64_t> present = random_keys(count, 0x9E3779B97F4A7C15ull);
+    std::vector<uint64_t> absent = random_keys(count, 0xD1B54A32D192ED03ull); // 64-bit random : no overlap in practice
+    auto report = [&](const char* name, auto& filter) {
+        for (uint64_t key : present) filter.insert(key);
+        size_t false_positives = 0;
+        double probe_ms = time_ms([&] {
+            for (uint64_t key : absent) false_positives += filter.may_contain(key);
+        });
+        cout << name << " : " << 100.0 * false_positives / count << " % false positives, " << 8.0 * filter.memory_bytes() / count
+             << " bits per key, " << probe_ms * 1e6 / count << " ns per miss" << endl;
+    };
+    for (double bits : {8.0, 10.0, 16.0}) {
+        BlockedBloomFilter<uint64_t> bloom(count, bits);
+        string name = "1M keys BlockedBloomFilter " + std::to_string(static_cast<int>(bits)) + " bits";
+        report(name.c_str(), bloom);
     }
+    CuckooFilter<uint64_t> cuckoo(count);
+    report("1M keys CuckooFilter               ", cuckoo);
 
-    // 12. Copy constructor
-    UnorderedSet(const UnorderedSet& other) : size_(other.size_), bucket_count_(other.bucket_count_), max_load_factor_(other.max_load_factor_) {
-        buckets = new std::vector<std::list<T>>(*other.buckets);
+    // Front-ends : 4M elements, 4M lookups that all miss
+    std::vector<uint64_t> elements = random_keys(4 * count, 0x2545F4914F6CDD1Dull);
+    std::vector<uint64_t> misses = random_keys(4 * count, 0x5851F42D4C957F2Dull);
+    auto misses_ms = [&](const char* name, auto& set) {
+        for (uint64_t element : elements) set.insert(element);
+        size_t found = 0;
+        double ms = time_ms([&] {
+            for (uint64_t key : misses) found += set.contains(key);
+        });
+        cout << "4M misses " << name << " " << ms << " ms (" << found << ")" << endl;
+    };
+    {
+        UnorderedSet<uint64_t> set;
+        misses_ms("UnorderedSet                   ", set);
+    }
+    {
+        FilteredSet<UnorderedSet<uint64_t>, BlockedBloomFilter<uint64_t>> set(4 * count);
+        misses_ms("UnorderedSet + BlockedBloom    ", set);
     }
+    {
+        FilteredSet<UnorderedSet<uint64_t>, CuckooFilter<uint64_t>> set(4 * count);
+        misses_ms("UnorderedSet + CuckooFilter    ", set);
+    }
+    {
+        FlatUnorderedSet<uint64_t> set;
+        misses_ms("FlatUnorderedSet               ", set);
+    }
+    {
+        FilteredSet<FlatUnorderedSet<uint64_t>, BlockedBloomFilter<uint64_t>> set(4 * count);
+        misses_ms("FlatUnorderedSet + BlockedBloom", set);
+    }
+}
 
-    // 13. Copy assignment operator
-    UnorderedSet& operator=(const UnorderedSet& other) {
-        if (this != &other) {
-            delete buckets;
-            size_ = other.size_;
-            bucket_count_ = other.bucket_count_;
-            max_load_factor_ = other.max_load_factor_;
-            buckets = new std::vector<std::list<T>>(*other.buckets);
+// Benchmark : threads deduplicating one stream into a ConcurrentInsertSet against a mutex around a set
+void benchmark_concurrent_set() {
+    const size_t count = 1 << 22;
+    // Every thread inserts count / threads keys out of `distinct` values : fewer distinct values, more threads racing per key
+    auto run = [&](size_t threads, size_t distinct, auto insert) {
+        std::atomic<size_t> added{0};
+        double ms = time_ms([&] {
+            std::vector<std::thread> workers;
+            for (size_t t = 0; t < threads; ++t) {
+                workers.emplace_back([&, t] {
+                    size_t mine = 0;
+                    uint64_t state = 0x9E3779B97F4A7C15ull * (t + 1);
+                    for (size_t i = 0; i < count / threads; ++i) {
+                        state ^= state << 13;
+                        state ^= state >> 7;
+                        state ^= state << 17;
+                        mine += insert(state % distinct);
+                    }
+                    added.fetch_add(mine);
+                });
+            }
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+        });
+        cout << " " << ms << " ms (" << added.load() << " new)";
+    };
+    for (size_t distinct : {count / 2, size_t(1024)}) {
+        for (size_t threads : {1, 2, 4, 8}) {
+            cout << "4M inserts of " << distinct << " distinct, " << threads << " threads :";
+            {
+                ConcurrentInsertSet<uint64_t> set;
+                cout << " ConcurrentInsertSet";
+                run(threads, distinct, [&](uint64_t key) { return set.insert(key); });
+            }
+            {
+                FlatUnorderedSet<uint64_t> set;
+                std::mutex lock;
+                cout << " ; mutex + FlatUnorderedSet";
+                run(threads, distinct, [&](uint64_t key) {
+                    std::lock_guard<std::mutex> guard(lock);
+                    return set.insert(key);
+                });
+            }
+            {
+                UnorderedSet<uint64_t> set;
+                std::mutex lock;
+                cout << " ; mutex + UnorderedSet";
+                run(threads, distinct, [&](uint64_t key) {
+                    std::lock_guard<std::mutex> guard(lock);
+                    return set.insert(key);
+                });
+            }
+            cout << endl;
         }
-        return *this;
     }
+}
 
-    // Move constructor
-    UnorderedSet(UnorderedSet&& other) noexcept : size_(other.size_), bucket_count_(other.bucket_count_), max_load_factor_(other.max_load_factor_) {
-        buckets = other.buckets;
-        other.buckets = nullptr;
-        other.size_ = 0;
-        other.bucket_count_ = 0;
+// Check : HyperLogLog error stays within its standard error, and merge equals the sketch of the union ; throws on failure
+void check_hyperloglog() {
+    // rms relative error over 200 independent streams of 50K distinct values, at p = 12 (1.6% standard error)
+    double squared = 0;
+    for (uint64_t stream = 0; stream < 200; ++stream) {
+        HyperLogLog<uint64_t> sketch(12);
+        for (uint64_t value = 0; value < 50000; ++value) sketch.insert(value + (stream << 40));
+        double relative = sketch.estimate() / 50000 - 1;
+        squared += relative * relative;
+    }
+    if (std::sqrt(squared / 200) > 3 * HyperLogLog<uint64_t>(12).standard_error()) {
+        throw std::logic_error("HyperLogLog: rms error above 3 standard errors");
     }
 
-    // Move assignment operator
-    UnorderedSet& operator=(UnorderedSet&& other) noexcept {
-        if (this != &other) {
-            delete buckets;
-            size_ = other.size_;
-            bucket_count_ = other.bucket_count_;
-            max_load_factor_ = other.max_load_factor_;
-            buckets = other.buckets;
-            other.buckets = nullptr;
-            other.size_ = 0;
-            other.bucket_count_ = 0;
+    // merge of every sparse / dense pair gives the same registers (same estimate) as one sketch fed both streams
+    for (uint64_t left : {100, 20000}) {
+        for (uint64_t right : {200, 30000}) {
+            HyperLogLog<uint64_t> a, b, both;
+            for (uint64_t value = 0; value < left; ++value) {
+                a.insert(value);
+                both.insert(value);
+            }
+            for (uint64_t value = left / 2; value < left / 2 + right; ++value) { // overlaps a
+                b.insert(value);
+                both.insert(value);
+            }
+            bool b_sparse = b.is_sparse();
+            a.merge(b);
+            if (b.is_sparse() != b_sparse || a.is_sparse() != both.is_sparse() || a.estimate() != both.estimate()) {
+                throw std::logic_error("HyperLogLog::merge differs from the sketch of the union");
+            }
         }
-        return *this;
     }
+}
 
-    // Destructor
-    ~UnorderedSet() {
-        /*
-            - will free the memory allocated for the std::vector itself.
-            - The std::vector destructor will then be called, which will free the memory allocated for the std::list objects.
-            - Each std::list destructor will then destroy all the T objects it contains.
-            - The destructor for each T object will be called.
-        */
-        delete buckets;
+// Benchmark : HyperLogLog error and memory against exact counting, and a sketch built by 4 threads then merged
+void benchmark_hyperloglog() {
+    for (size_t distinct : {size_t(100), size_t(10000), size_t(100000), size_t(1000000), size_t(10000000)}) {
+        // Every value appears twice, so the stream is twice the distinct count
+        HyperLogLog<uint64_t> sketch;
+        double sketch_ms = time_ms([&] {
+            for (size_t pass = 0; pass < 2; ++pass) {
+                for (uint64_t value = 0; value < distinct; ++value) sketch.insert(value * 0x2545F4914F6CDD1Dull);
+            }
+        });
+        double error = 100.0 * (sketch.estimate() - static_cast<double>(distinct)) / static_cast<double>(distinct);
+        cout << distinct << " distinct : HyperLogLog " << sketch.size() << " (" << error << " % error, " << (sketch.is_sparse() ? "sparse, " : "dense, ")
+             << sketch.memory_bytes() << " bytes, " << sketch_ms << " ms)";
+        if (distinct <= 1000000) {
+            size_t before = heap_bytes_in_use();
+            FlatUnorderedSet<uint64_t> exact;
+            double exact_ms = time_ms([&] {
+                for (size_t pass = 0; pass < 2; ++pass) {
+                    for (uint64_t value = 0; value < distinct; ++value) exact.insert(value * 0x2545F4914F6CDD1Dull);
+                }
+            });
+            cout << " ; FlatUnorderedSet " << exact.size() << " (" << heap_bytes_in_use() - before << " bytes, " << exact_ms << " ms)";
+        }
+        cout << endl;
     }
 
-  
-};
+    // Error spread at p = 14 : 100 independent streams of 1M distinct values
+    double squared = 0;
+    for (uint64_t stream = 0; stream < 100; ++stream) {
+        HyperLogLog<uint64_t> sketch;
+        for (uint64_t value = 0; value < 1000000; ++value) sketch.insert(value + (stream << 40));
+        double relative = sketch.estimate() / 1e6 - 1;
+        squared += relative * relative;
+    }
+    cout << "1M distinct, 100 streams : rms error " << 100.0 * std::sqrt(squared / 100) << " %, expected "
+         << 100.0 * HyperLogLog<uint64_t>().standard_error() << " %" << endl;
+
+    // 4 threads sketch a quarter of a 10M stream each, merged afterwards
+    const size_t threads = 4, count = 10000000;
+    std::vector<HyperLogLog<uint64_t>> parts(threads);
+    double parallel_ms = time_ms([&] {
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                for (uint64_t value = t; value < count; value += threads) parts[t].insert(value);
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        for (size_t t = 1; t < threads; ++t) {
+            parts[0].merge(parts[t]);
+        }
+    });
+    cout << "10M distinct, 4 threads + merge : " << parts[0].size() << " in " << parallel_ms << " ms" << endl;
+}
+
+// Benchmark : building a set of known size with and without reserve, a full scan, and erase_if against erasing one by one
+void benchmark_reserve_and_scan(size_t count) {
+    std::vector<uint64_t> values(count);
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for (uint64_t& value : values) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        value = state;
+    }
+    UnorderedSet<uint64_t> grown, reserved;
+    double grown_ms = time_ms([&] {
+        for (uint64_t value : values) grown.insert(value);
+    });
+    double reserved_ms = time_ms([&] {
+        reserved.reserve(count);
+        for (uint64_t value : values) reserved.insert(value);
+    });
+    uint64_t sum = 0;
+    double scan_ms = time_ms([&] {
+        for (uint64_t value : reserved) sum += value;
+    });
+    UnorderedSet<uint64_t> copy = reserved;
+    double erase_if_ms = time_ms([&] { sum += reserved.erase_if([](uint64_t value) { return value % 2 == 0; }); });
+    double erase_loop_ms = time_ms([&] {
+        for (uint64_t value : values) {
+            if (value % 2 == 0) copy.erase(value);
+        }
+    });
+    cout << count << " uint64_t : insert from 10 buckets " << grown_ms << " ms, after reserve " << reserved_ms << " ms ; scan " << scan_ms
+         << " ms ; erase half with erase_if " << erase_if_ms << " ms, one by one " << erase_loop_ms << " ms (" << sum % 10 << ")" << endl;
+}
 
 // Main function
-int main() {
+int main(int argc, char* argv[]) {
     /* Logic for UnorderedSet implementation:
     UnorderedSet
    |
-   +-- Vector of Buckets
-       |
-       +-- Bucket 0: [E1] -> [E2] -> nullptr
-       |
-       +-- Bucket 1: [E3] -> nullptr
-       |
-   - Each Bucket is a linked list of elements
+   +-- Vector of Buckets : index of the first element of the chain
+   |   |
+   |   +-- Bucket 0: 0 -> 2 -> npos
+   |   |
+   |   +-- Bucket 1: 1 -> npos
+   |
+   +-- Elements (contiguous) : [E0] [E1] [E2]
+   +-- Links (same indexes)   : {hash, next} for each element
+   |
    - The hash function determines which bucket an element goes into
-   - Collisions are handled by adding to the same bucket (linked list)
-   - Keep track of number of elements and buckets (size_ and bucket_count_)
+   - Collisions are handled by chaining through the links (next index)
+   - Elements stay contiguous : iteration is a linear sweep, erase moves the last element into the hole
    - Use load factor to determine when to resize the hash table
-   - Maintain max_load_factor to trigger resizing when exceeded
+   - Maintain max_load_factor to trigger resizing when exceeded ; rehash only rebuilds the chains from the cached hashes
    - Ensure uniqueness of elements (no duplicates allowed)
     */
 
@@ -219,6 +2619,94 @@ int main() {
     UnorderedSet<int> set5 = std::move(set3); // move ctor
     UnorderedSet<int> set6;
     set6 = std::move(set5); // move assignment
+    cout << set5.load_factor() << set5.bucket_count(); // moved-from : empty, no buckets until the next insert
+
+    UnorderedSet<int> ports;
+    ports.reserve(100); // reserve : no rehash for the next 100 inserts
+    for (int port = 8000; port < 8100; ++port) {
+        ports.insert(port);
+    }
+    for (int port : ports) { // iteration over contiguous storage
+        cout << (port == 8000);
+    }
+    cout << ports.erase_if([](int port) { return port % 2 == 1; }); // erase_if : one pass, returns 50
+    for (auto it = ports.begin(); it != ports.end();) { // erase while iterating : continue from the returned iterator
+        it = *it % 4 == 0 ? ports.erase(it) : std::next(it);
+    }
+    cout << ports.size();
+
+    FlatUnorderedSet<string> tags; // FlatUnorderedSet : same API, elements inline in one slot array
+    tags.insert("red"); // insert : one SSE2 compare finds the candidate slots of a group
+    tags.insert("blue");
+    tags.erase("red"); // erase : slot becomes empty again, or a tombstone in a full group
+    cout << tags.contains("blue") << tags.size() << tags.bucket_count() << tags.memory_bytes(); // contains , size , bucket_count , memory_bytes
+
+    FlatUnorderedSet<string> other_tags;
+    other_tags.insert("blue");
+    other_tags.insert("green");
+    cout << intersection_of(tags, other_tags).size() << union_of(tags, other_tags).size() << difference_of(other_tags, tags).size(); // intersection_of , union_of , difference_of
+    unite_with(tags, other_tags); // unite_with : tags = tags | other_tags
+    subtract(set6, set2); // subtract : set6 = set6 - set2
+    intersect_with(tags, other_tags, 4); // intersect_with : threads only used past kParallelMin elements
+    tags.for_each([](const string& tag) { cout << tag; }); // for_each
+
+    FilteredSet<UnorderedSet<string>, CuckooFilter<string>> sessions(1000); // FilteredSet : filter sized for 1000 elements, grows with the set
+    sessions.insert("alice"); // insert : goes to the set and the filter
+    sessions.insert("bob");
+    sessions.erase("bob"); // erase : the cuckoo filter drops the fingerprint too
+    cout << sessions.contains("alice") << sessions.contains("carol") << sessions.size(); // contains : a miss usually stops at the filter
+    ConcurrentInsertSet<string> crawled; // ConcurrentInsertSet : insert-only, any number of threads, no lock
+    std::vector<std::thread> crawlers;
+    std::atomic<int> fresh{0};
+    for (int t = 0; t < 4; ++t) {
+        crawlers.emplace_back([&crawled, &fresh] {
+            for (int page = 0; page < 100; ++page) {
+                fresh += crawled.insert("https://example.com/" + std::to_string(page)); // insert : true for the one thread that added it
+            }
+        });
+    }
+    for (std::thread& crawler : crawlers) {
+        crawler.join();
+    }
+    cout << fresh << crawled.size() << crawled.contains("https://example.com/7"); // size , contains
+    HyperLogLog<string> visitors; // HyperLogLog : distinct count estimate in at most 16 KB
+    HyperLogLog<string> other_visitors;
+    for (int i = 0; i < 3000; ++i) {
+        visitors.insert("user" + std::to_string(i)); // insert
+        other_visitors.insert("user" + std::to_string(i + 2000));
+    }
+    visitors.merge(other_visitors); // merge : sketch of both streams (5000 distinct)
+    cout << visitors.size() << visitors.is_sparse() << visitors.memory_bytes(); // size : estimate , is_sparse , memory_bytes
+    check_hyperloglog();
+    BlockedBloomFilter<int> seen(1000, 10); // BlockedBloomFilter : 1000 keys at 10 bits each
+    seen.insert(42);
+    cout << seen.may_contain(42) << seen.memory_bytes(); // may_contain , memory_bytes
+
+    RoaringSet ids; // RoaringSet : 32-bit integers in array, bitmap or run containers per 64K chunk
+    ids.insert_range(1000, 200000); // insert_range : stored as one run per chunk
+    ids.insert(7); // insert
+    ids.erase(1500); // erase : splits the run
+    RoaringSet banned;
+    banned.insert_range(150000, 300000);
+    cout << ids.contains(7) << ids.contains(1500) << ids.size() << (ids & banned).size() << (ids - banned).size() << (ids | banned).size(); // contains , size , & , - , |
+    ids.optimize(); // optimize : smallest container for every chunk
+    check_roaring();
+    cout << ids.memory_bytes(); // memory_bytes
+
+    // Benchmarks only run on request : ./a.out --bench
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        cout << endl;
+        benchmark_sets(1 << 16);
+        benchmark_sets(1 << 22);
+        benchmark_reserve_and_scan(1 << 22);
+        benchmark_roaring();
+        benchmark_set_algebra<FlatUnorderedSet<uint64_t>>("FlatUnorderedSet", 1 << 22, 1 << 22);
+        benchmark_set_algebra<FlatUnorderedSet<uint64_t>>("FlatUnorderedSet", 1 << 22, 1 << 14);
+        benchmark_set_algebra<UnorderedSet<uint64_t>>("UnorderedSet    ", 1 << 22, 1 << 14);
+        benchmark_filters();
+        benchmark_concurrent_set();
+        benchmark_hyperloglog();
+    }
 
     return 0;
 }
\ No newline at end of file